@@ -0,0 +1,201 @@
+/**
+*	Switches between event-driven and levelized evaluation of a Netlist by measured activity.
+*/
+#ifndef SYNCHROTRONADAPTIVE_HPP
+#define SYNCHROTRONADAPTIVE_HPP
+
+#include "SynchrotronEventDriven.hpp"
+#include "SynchrotronLevelized.hpp"
+
+#include <vector>
+
+namespace Synchrotron {
+
+	/** \brief
+	 *	AdaptiveEngine settles a Netlist after each stimulus with whichever engine
+	 *	suits the current activity factor: the fraction of components whose state
+	 *	an evaluation changed during a step. Each component counts once, however
+	 *	often a cycle changed it, so the factor stays within [0, 1]. Sources set
+	 *	before the step only count when their own evaluation changes them again,
+	 *	in either mode.
+	 *
+	 *	Event-driven propagation only pays for what changes and wins at low activity;
+	 *	levelized evaluation pays for every component but has no scheduling overhead,
+	 *	and wins once most of the netlist toggles. The activity factor is smoothed
+	 *	(exponential moving average) and compared against two thresholds: above
+	 *	`high` the engine switches to levelized, below `low` back to event-driven.
+	 *	The gap between them keeps the engine from flapping around a single threshold.
+	 *
+	 *	Both modes settle to the same states, those of LevelizedEngine::step():
+	 *	every component, sources included, holds the fold of its own state and
+	 *	its inputs. Switching therefore never changes results.
+	 *
+	 *	\param	bit_width
+	 *		This template argument specifies the width of the internal bitset state.
+	 */
+	template <size_t bit_width>
+	class AdaptiveEngine {
+		public:
+			enum Mode { EventDriven, Levelized };
+
+			/**	\brief	Counters of the decisions taken so far.
+			 */
+			struct Stats {
+				uint64_t	steps;				// Total propagate() calls
+				uint64_t	eventSteps;			// ... settled event-driven
+				uint64_t	levelizedSteps;		// ... settled levelized
+				uint64_t	switches;			// Mode changes
+				double		activity;			// Smoothed activity factor
+				double		lastActivity;		// Activity factor of the last step
+				Mode		mode;				// Mode of the next step
+			};
+
+		private:
+			Netlist<bit_width>			&netlist;
+			EventDrivenEngine<bit_width>	events;
+			LevelizedEngine<bit_width>	levelized;
+			ThreadPool					*pool;
+
+			double	low, high, smoothing;
+			Stats	statistics;
+
+			/**	\brief	Folds the activity of one step, which changed components, into the average and decides the next mode.
+			 */
+			void sample(size_t components) {
+				Stats &s = this->statistics;
+
+				s.lastActivity	= this->netlist.size() ? double(components) / this->netlist.size() : 0;
+				s.activity		+= this->smoothing * (s.lastActivity - s.activity);
+
+				const Mode next = (s.mode == EventDriven)
+					? (s.activity > this->high	? Levelized		: EventDriven)
+					: (s.activity < this->low	? EventDriven	: Levelized);
+
+				if (next != s.mode) s.switches++;
+				s.mode = next;
+			}
+
+		public:
+			/**	\brief	Default constructor
+			 *
+			 *	\param	netlist
+			 *		The Netlist to evaluate; its topology must not change afterwards.
+			 *	\param	pool
+			 *		Workers for the levelized steps, or nullptr to evaluate on the calling thread.
+			 */
+			AdaptiveEngine(Netlist<bit_width>& netlist, ThreadPool* pool = nullptr)
+				: netlist(netlist), events(netlist), levelized(netlist), pool(pool),
+				  low(0.05), high(0.20), smoothing(0.125)
+			{
+				const Stats none = { 0, 0, 0, 0, 0, 0, EventDriven };
+				this->statistics = none;
+			}
+
+			/**	\brief	Sets the hysteresis band of the smoothed activity factor.
+			 *
+			 *	\param	low
+			 *		Below this the engine switches to event-driven (default 0.05).
+			 *	\param	high
+			 *		Above this the engine switches to levelized (default 0.20), at least low.
+			 *	\param	smoothing
+			 *		Weight of the newest sample in the moving average, in (0, 1] (default 1/8).
+			 */
+			void setThresholds(double low, double high, double smoothing = 0.125) {
+				this->low		= low;
+				this->high		= (high < low) ? low : high;
+				this->smoothing	= smoothing;
+			}
+
+			/**	\brief	Forces the mode of the next step; later steps adapt again.
+			 */
+			inline void setMode(Mode mode) {
+				this->statistics.mode = mode;
+			}
+
+			/**	\brief	Gets the decision statistics.
+			 */
+			inline const Stats& stats() const {
+				return this->statistics;
+			}
+
+			/**	\brief	Enables the deterministic mode on both engines, see their setLog().
+			 */
+			inline void setLog(CommitLog<bit_width>* log) {
+				this->events.setLog(log);
+				this->levelized.setLog(log);
+			}
+
+			/**	\brief	Settles the Netlist after the states of sources changed.
+			 *
+			 *	The sources must already have their new working state (Netlist::setState()).
+			 *
+			 *	\param	sources
+			 *		Indices of the components whose state changed.
+			 *	\param	count
+			 *		The amount of sources.
+			 *
+			 *	\return	size_t
+			 *		Returns the amount of evaluations that changed a state.
+			 */
+			size_t propagate(const size_t* sources, size_t count) {
+				size_t changed, components;
+				this->statistics.steps++;
+
+				if (this->statistics.mode == EventDriven) {
+					this->statistics.eventSteps++;
+
+					// Like a levelized step, the sources themselves evaluate too
+					for(const size_t *s = sources; s != sources + count; ++s) {
+						this->events.schedule(*s);
+						this->events.changed(*s);
+					}
+
+					this->events.propagate();
+					changed		= this->events.modified();
+					components	= this->events.changedComponents();
+				} else {
+					this->statistics.levelizedSteps++;
+					changed		= this->pool ? this->levelized.step(*this->pool) : this->levelized.step();
+					components	= this->levelized.changedComponents();
+				}
+
+				this->sample(components);
+				return changed;
+			}
+
+			/**	\brief	Settles the Netlist after the states of sources changed.
+			 */
+			inline size_t propagate(const std::vector<size_t>& sources) {
+				return this->propagate(sources.data(), sources.size());
+			}
+
+			/**	\brief	Sets a new state on component c and settles the Netlist.
+			 *
+			 *	\return	size_t
+			 *		Returns the amount of evaluations that changed a state.
+			 */
+			size_t emit(SynchrotronComponent<bit_width>& c, const std::bitset<bit_width>& value) {
+				const size_t i = this->netlist.indexOf(&c);
+				if (i == Netlist<bit_width>::npos) return 0;
+
+				this->netlist.setState(i, value);
+				return this->propagate(&i, 1);
+			}
+
+			/**	\brief	Sets a new state on the component h refers to and settles the Netlist.
+			 *
+			 *	\return	size_t
+			 *		Returns the amount of evaluations that changed a state, 0 when h is stale.
+			 */
+			size_t emit(const Handle& h, const std::bitset<bit_width>& value) {
+				const size_t i = this->netlist.indexOf(h);
+				if (i == Netlist<bit_width>::npos) return 0;
+
+				this->netlist.setState(i, value);
+				return this->propagate(&i, 1);
+			}
+	};
+
+}
+
+#endif // SYNCHROTRONADAPTIVE_HPP
@@ -0,0 +1,262 @@
+/**
+*	Low latency barriers for synchronising the workers of a ThreadPool.
+*/
+#ifndef SYNCHROTRONBARRIER_HPP
+#define SYNCHROTRONBARRIER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#ifndef SYNCHROTRON_CACHE_LINE
+	#define SYNCHROTRON_CACHE_LINE	64
+#endif
+
+#ifndef SYNCHROTRON_BARRIER_SPINS
+	#define SYNCHROTRON_BARRIER_SPINS	4096
+#endif
+
+namespace Synchrotron {
+
+	/**	\brief
+	 *	Base of the types aligned to cache lines, whose heap allocations it aligns
+	 *	too: before C++17, plain `new` ignores alignments above the default one.
+	 *
+	 *	Types holding a cache line aligned member derive from it as well.
+	 */
+	struct CacheAligned {
+		static void* operator new(size_t size)			{ return allocate(size);	}
+		static void* operator new[](size_t size)		{ return allocate(size);	}
+		static void operator delete(void* p) noexcept	{ deallocate(p);			}
+		static void operator delete[](void* p) noexcept	{ deallocate(p);			}
+
+		/**	\brief	Allocates size bytes at the start of a cache line.
+		 */
+		static void* allocate(size_t size) {
+			void *raw = std::malloc(size + SYNCHROTRON_CACHE_LINE);
+			if (!raw) throw std::bad_alloc();
+
+			// At least a pointer past raw, room to remember it right before the block
+			void **block = reinterpret_cast<void**>((reinterpret_cast<uintptr_t>(raw) + SYNCHROTRON_CACHE_LINE) & ~uintptr_t(SYNCHROTRON_CACHE_LINE - 1));
+			block[-1] = raw;
+			return block;
+		}
+
+		/**	\brief	Frees a block from allocate().
+		 */
+		static void deallocate(void* p) noexcept {
+			if (p) std::free(static_cast<void**>(p)[-1]);
+		}
+	};
+
+	/**	\brief
+	 *	Aligns T to a cache line and rounds its size up to whole lines, so
+	 *	neighbouring elements written by different workers never share a line.
+	 */
+	template <class T>
+	struct alignas(SYNCHROTRON_CACHE_LINE) Padded : CacheAligned {
+		T		value;
+	};
+
+	/**	\brief
+	 *	Spin-then-park waiting on a sense flag shared by both barriers.
+	 *
+	 *	Waiters spin on `sense` for a while, then sleep on a condition variable.
+	 *	The releaser only touches the mutex when somebody actually parked.
+	 */
+	class Parking {
+		private:
+			std::mutex				m_mutex;
+			std::condition_variable	wakeup;
+			std::atomic<size_t>		parked;
+			char					padding[SYNCHROTRON_CACHE_LINE];
+
+		public:
+			std::atomic<bool>		sense;
+
+			Parking() : parked(0), sense(false) {}
+
+			/**	\brief	Waits until sense equals local.
+			 *
+			 *	\param	local
+			 *		The sense the caller waits for.
+			 *	\param	spins
+			 *		Amount of polls before parking the thread.
+			 */
+			void await(bool local, size_t spins) {
+				for(size_t i = 0; i < spins; i++)
+					if (this->sense.load(std::memory_order_acquire) == local) return;
+
+				std::unique_lock<std::mutex> lock(this->m_mutex);
+				this->parked.fetch_add(1, std::memory_order_seq_cst);
+				while (this->sense.load(std::memory_order_seq_cst) != local)
+					this->wakeup.wait(lock);
+				this->parked.fetch_sub(1, std::memory_order_relaxed);
+			}
+
+			/**	\brief	Publishes local as the new sense and wakes parked waiters.
+			 */
+			void release(bool local) {
+				this->sense.store(local, std::memory_order_seq_cst);
+
+				if (this->parked.load(std::memory_order_seq_cst) != 0) {
+					std::lock_guard<std::mutex> lock(this->m_mutex);
+					this->wakeup.notify_all();
+				}
+			}
+	};
+
+	/** \brief
+	 *	Centralised sense-reversing barrier.
+	 *
+	 *	All workers decrement one shared counter, the last one resets it
+	 *	and flips the global sense. Cheapest for a handful of workers.
+	 */
+	class SenseBarrier : public CacheAligned {
+		private:
+			const size_t					parties, spins;
+			Padded<std::atomic<size_t> >	count;
+			Parking							parking;
+
+			/**	\brief	Per worker sense, padded to avoid false sharing.
+			 */
+			std::unique_ptr<Padded<bool>[]>	local;
+
+		public:
+			/**	\brief	Default constructor
+			 *
+			 *	\param	parties
+			 *		The amount of workers taking part.
+			 *	\param	spins
+			 *		Amount of polls before a waiting worker parks.
+			 */
+			SenseBarrier(size_t parties, size_t spins = SYNCHROTRON_BARRIER_SPINS)
+				: parties(parties), spins(spins), local(new Padded<bool>[parties])
+			{
+				this->count.value.store(parties, std::memory_order_relaxed);
+				for(size_t i = 0; i < parties; i++) this->local[i].value = false;
+			}
+
+			/**	\brief	Blocks until all parties called wait().
+			 *
+			 *	\param	worker
+			 *		The id of the calling worker, in [0, parties).
+			 */
+			void wait(size_t worker) {
+				const bool sense = !this->local[worker].value;
+				this->local[worker].value = sense;
+
+				if (this->count.value.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+					this->count.value.store(this->parties, std::memory_order_relaxed);
+					this->parking.release(sense);
+				} else {
+					this->parking.await(sense, this->spins);
+				}
+			}
+	};
+
+	/** \brief
+	 *	Combining tree barrier with a central sense release.
+	 *
+	 *	Workers arrive at a leaf shared by at most `fanin` workers, the last arrival
+	 *	of each node continues to its parent. Only the last arrival at the root flips the sense,
+	 *	so no counter is contended by more than `fanin` workers.
+	 *	With `parties <= fanin` this is the same as a SenseBarrier.
+	 */
+	class TreeBarrier {
+		private:
+			struct Counter {
+				std::atomic<size_t>	count;
+				size_t				expected;
+				size_t				parent;
+			};
+			typedef Padded<Counter> Node;
+
+			static const size_t root = size_t(-1);
+
+			const size_t					parties, spins, fanin;
+			std::unique_ptr<Node[]>			nodes;
+			std::vector<size_t>				leaf;
+			Parking							parking;
+			std::unique_ptr<Padded<bool>[]>	local;
+
+		public:
+			/**	\brief	Default constructor
+			 *
+			 *	\param	parties
+			 *		The amount of workers taking part.
+			 *	\param	fanin
+			 *		The amount of arrivals combined per tree node.
+			 *	\param	spins
+			 *		Amount of polls before a waiting worker parks.
+			 */
+			TreeBarrier(size_t parties, size_t fanin = 4, size_t spins = SYNCHROTRON_BARRIER_SPINS)
+				: parties(parties), spins(spins), fanin(fanin < 2 ? 2 : fanin),
+				  leaf(parties), local(new Padded<bool>[parties])
+			{
+				// Lay out the tree level by level, leaves first
+				std::vector<size_t> expected;
+				std::vector<size_t> parent;
+				size_t level = 0, width = parties;
+
+				for(size_t i = 0; i < parties; i++)
+					this->leaf[i] = i / this->fanin;
+
+				do {
+					const size_t nodes = (width + this->fanin - 1) / this->fanin;
+					const size_t next  = level + nodes;
+
+					for(size_t n = 0; n < nodes; n++) {
+						expected.push_back(std::min(this->fanin, width - n * this->fanin));
+						parent.push_back(nodes == 1 ? root : next + n / this->fanin);
+					}
+
+					level = next;
+					width = nodes;
+				} while (width > 1);
+
+				this->nodes.reset(new Node[expected.size()]);
+				for(size_t n = 0; n < expected.size(); n++) {
+					this->nodes[n].value.count.store(expected[n], std::memory_order_relaxed);
+					this->nodes[n].value.expected	= expected[n];
+					this->nodes[n].value.parent		= parent[n];
+				}
+
+				for(size_t i = 0; i < parties; i++) this->local[i].value = false;
+			}
+
+			/**	\brief	Blocks until all parties called wait().
+			 *
+			 *	\param	worker
+			 *		The id of the calling worker, in [0, parties).
+			 */
+			void wait(size_t worker) {
+				const bool sense = !this->local[worker].value;
+				this->local[worker].value = sense;
+
+				for(size_t n = this->leaf[worker]; n != root; n = this->nodes[n].value.parent) {
+					Counter &node = this->nodes[n].value;
+
+					if (node.count.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+						this->parking.await(sense, this->spins);
+						return;
+					}
+
+					// Last arrival: reset for the next episode and combine upwards
+					node.count.store(node.expected, std::memory_order_relaxed);
+				}
+
+				this->parking.release(sense);
+			}
+	};
+
+}
+
+#endif // SYNCHROTRONBARRIER_HPP
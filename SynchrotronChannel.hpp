@@ -0,0 +1,209 @@
+/**
+*	Bounded lock-free channels for passing events between worker threads.
+*/
+#ifndef SYNCHROTRONCHANNEL_HPP
+#define SYNCHROTRONCHANNEL_HPP
+
+#include "SynchrotronBarrier.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace Synchrotron {
+
+	/**	\brief	Rounds n up to a power of two (at least 1).
+	 */
+	inline size_t roundUp(size_t n) {
+		size_t p = 1;
+		while (p < n) p <<= 1;
+		return p;
+	}
+
+	/** \brief
+	 *	Single producer, single consumer ring buffer.
+	 *
+	 *	The producer only writes `tail`, the consumer only writes `head`,
+	 *	so neither side ever needs a lock or a CAS. Each side keeps a cached
+	 *	copy of the other index on its own cache line and only reloads it
+	 *	when the ring looks full (empty), so the lines rarely bounce.
+	 *
+	 *	\param	T
+	 *		The (trivially copyable) record type.
+	 */
+	template <class T>
+	class SpscChannel : public CacheAligned {
+		private:
+			struct End {
+				std::atomic<size_t>	index;
+				size_t				other;	// Cached index of the opposite end
+			};
+
+			const size_t			mask;
+			std::unique_ptr<T[]>	ring;
+
+			Padded<End>	head;
+			Padded<End>	tail;
+
+		public:
+			/**	\brief	Default constructor
+			 *
+			 *	\param	capacity
+			 *		Minimal amount of records the channel can hold, rounded up to a power of two.
+			 */
+			SpscChannel(size_t capacity = 1024)
+				: mask(roundUp(capacity) - 1), ring(new T[mask + 1])
+			{
+				this->head.value.index.store(0, std::memory_order_relaxed);
+				this->tail.value.index.store(0, std::memory_order_relaxed);
+				this->head.value.other = this->tail.value.other = 0;
+			}
+
+			/**	\brief	Appends a record (producer only).
+			 *
+			 *	\return	bool
+			 *		Returns false when the channel is full.
+			 */
+			bool push(const T& record) {
+				End &tail = this->tail.value;
+				const size_t t = tail.index.load(std::memory_order_relaxed);
+
+				if (t - tail.other > this->mask) {
+					tail.other = this->head.value.index.load(std::memory_order_acquire);
+					if (t - tail.other > this->mask) return false;
+				}
+
+				this->ring[t & this->mask] = record;
+				tail.index.store(t + 1, std::memory_order_release);
+				return true;
+			}
+
+			/**	\brief	Takes the oldest record (consumer only).
+			 *
+			 *	\return	bool
+			 *		Returns false when the channel is empty.
+			 */
+			bool pop(T& record) {
+				End &head = this->head.value;
+				const size_t h = head.index.load(std::memory_order_relaxed);
+
+				if (h == head.other) {
+					head.other = this->tail.value.index.load(std::memory_order_acquire);
+					if (h == head.other) return false;
+				}
+
+				record = this->ring[h & this->mask];
+				head.index.store(h + 1, std::memory_order_release);
+				return true;
+			}
+
+			/**	\brief	Gets the amount of records the channel can hold.
+			 */
+			inline size_t capacity() const {
+				return this->mask + 1;
+			}
+	};
+
+	/** \brief
+	 *	Multiple producer, single consumer ring buffer.
+	 *
+	 *	Every slot carries a sequence number telling whose turn it is:
+	 *	producers claim a slot with one CAS on `tail`, fill it and publish it
+	 *	by bumping its sequence; the consumer waits for that sequence and
+	 *	hands the slot back to the producers of the next lap. A producer that
+	 *	stalls between claiming and publishing only delays the consumer,
+	 *	never the other producers.
+	 *
+	 *	\param	T
+	 *		The (trivially copyable) record type.
+	 */
+	template <class T>
+	class MpscChannel : public CacheAligned {
+		private:
+			struct Slot {
+				std::atomic<size_t>	sequence;
+				T					record;
+			};
+
+			const size_t				mask;
+			std::unique_ptr<Slot[]>		ring;
+
+			Padded<size_t>					head;
+			Padded<std::atomic<size_t> >	tail;
+
+		public:
+			/**	\brief	Default constructor
+			 *
+			 *	\param	capacity
+			 *		Minimal amount of records the channel can hold, rounded up to a power of two.
+			 */
+			MpscChannel(size_t capacity = 1024)
+				: mask(roundUp(capacity) - 1), ring(new Slot[mask + 1])
+			{
+				for(size_t i = 0; i <= this->mask; i++)
+					this->ring[i].sequence.store(i, std::memory_order_relaxed);
+
+				this->head.value = 0;
+				this->tail.value.store(0, std::memory_order_relaxed);
+			}
+
+			/**	\brief	Appends a record (any thread).
+			 *
+			 *	\return	bool
+			 *		Returns false when the channel is full.
+			 */
+			bool push(const T& record) {
+				size_t t = this->tail.value.load(std::memory_order_relaxed);
+
+				for(;;) {
+					Slot &slot = this->ring[t & this->mask];
+					const ptrdiff_t lap = ptrdiff_t(slot.sequence.load(std::memory_order_acquire) - t);
+
+					if (lap == 0) {
+						if (this->tail.value.compare_exchange_weak(t, t + 1, std::memory_order_relaxed)) {
+							slot.record = record;
+							slot.sequence.store(t + 1, std::memory_order_release);
+							return true;
+						}
+					} else if (lap < 0) {
+						return false;	// The consumer did not free this slot yet
+					} else {
+						t = this->tail.value.load(std::memory_order_relaxed);
+					}
+				}
+			}
+
+			/**	\brief	Takes the oldest published record (consumer only).
+			 *
+			 *	\return	bool
+			 *		Returns false when the channel is empty, or the oldest slot is not published yet.
+			 */
+			bool pop(T& record) {
+				const size_t h = this->head.value;
+				Slot &slot = this->ring[h & this->mask];
+
+				if (slot.sequence.load(std::memory_order_acquire) != h + 1) return false;
+
+				record = slot.record;
+				slot.sequence.store(h + this->mask + 1, std::memory_order_release);
+				this->head.value = h + 1;
+				return true;
+			}
+
+			/**	\brief	Gets the amount of records the channel can hold.
+			 */
+			inline size_t capacity() const {
+				return this->mask + 1;
+			}
+
+			/**	\brief	Gets the amount of records pushed so far (any thread); pop() takes them in this order.
+			 */
+			inline size_t pushed() const {
+				return this->tail.value.load(std::memory_order_acquire);
+			}
+	};
+
+}
+
+#endif // SYNCHROTRONCHANNEL_HPP
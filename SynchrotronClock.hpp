@@ -0,0 +1,361 @@
+/**
+*	Clock domains and a scheduler that advances a Netlist from edge to edge.
+*/
+#ifndef SYNCHROTRONCLOCK_HPP
+#define SYNCHROTRONCLOCK_HPP
+
+#include "SynchrotronDirty.hpp"
+#include "SynchrotronEvent.hpp"
+#include "SynchrotronIngress.hpp"
+#include "SynchrotronNetlist.hpp"
+#include "SynchrotronTrace.hpp"
+#include "SynchrotronWatch.hpp"
+
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace Synchrotron {
+
+	/** \brief
+	 *	A clock with edges at `phase + k * period`, and the components it drives.
+	 *
+	 *	The clock can be gated: an edge only ticks while `enabled` is set and,
+	 *	if there is an `enable` component, its state is not all zero.
+	 */
+	struct ClockDomain {
+		SimTime				period, phase;
+		std::vector<Index>	members;
+		uint64_t			edges;		// Edges that ticked so far
+		uint64_t			gated;		// Edges skipped while disabled
+		bool				enabled;	// Software enable
+		size_t				enable;		// Component whose state enables the clock, or ClockScheduler::none
+	};
+
+	/** \brief
+	 *	ClockScheduler advances a Netlist from one clock edge to the next, across
+	 *	any amount of clock domains.
+	 *
+	 *	Components subscribed to a domain are clocked: they only evaluate on an
+	 *	edge of their domain. All other components are combinational and evaluate
+	 *	whenever an input changed. Clocked components are registers: on an edge
+	 *	the members of every domain ticking at that time first all sample their
+	 *	inputs, then all take their new states at once, so a register fed by
+	 *	another register of the same edge sees the state from before the edge,
+	 *	whatever the order of domains and members. Their changes then propagate
+	 *	wave by wave through the combinational logic until it settles; clocked
+	 *	components reached on the way wait for their own edge.
+	 *
+	 *	The upcoming edges sit in a min-heap, so a step only touches the domains
+	 *	that tick: a domain that is not due costs nothing, whatever its size.
+	 *	Gating (setEnabled(), setEnable()) extends this to due domains that are
+	 *	disabled: their members are skipped entirely, not ticked to find no change.
+	 *	Enables are sampled for all due domains before any of them ticks.
+	 *
+	 *	Writes from other threads (setIngress()) are applied at the start of every step.
+	 *	Watchpoints (setWatchpoints()) are checked at the end of every step, and
+	 *	run() stops after the step at which one triggered.
+	 *
+	 *	With a CommitLog (setLog()) changes are recorded with the edge time as step.
+	 *
+	 *	\param	bit_width
+	 *		This template argument specifies the width of the internal bitset state.
+	 */
+	template <size_t bit_width>
+	class ClockScheduler {
+		public:
+			typedef size_t Domain;
+
+			/**	\brief	Domain of combinational components.
+			 */
+			static const Domain none = Domain(-1);
+
+		private:
+			struct Edge {
+				SimTime	time;
+				Domain	domain;
+
+				inline bool operator> (const Edge& other) const {
+					if (this->time != other.time) return this->time > other.time;
+					return this->domain > other.domain;
+				}
+			};
+
+			Netlist<bit_width>			&netlist;
+			std::vector<ClockDomain>	domains;
+			std::vector<Domain>			clockOf;
+
+			std::priority_queue<Edge, std::vector<Edge>, std::greater<Edge> >	upcoming;
+
+			/**	\brief	Enabled domains with an edge at the current time.
+			 */
+			std::vector<Domain>	due;
+
+			/**	\brief	States the members of the due domains sampled, committed together.
+			 */
+			std::vector<std::pair<Index, typename Netlist<bit_width>::Word> >	latched;
+
+			DirtySet			current, next;
+			SimTime				time;
+			size_t				evaluations;
+
+			CommitLog<bit_width>	*log;
+			Ingress<bit_width>		*ingress;
+			Watchpoints<bit_width>	*watchpoints;
+
+			/**	\brief	Evaluates component i and marks its outputs when it changed.
+			 */
+			inline void tick(size_t i) {
+				this->evaluations++;
+				if (!this->netlist.evaluate(i)) return;
+
+				if (this->log) this->log->record(0, this->time, i, this->netlist.getState(i));
+				this->changed(i);
+			}
+
+			/**	\brief	Gets whether domain d ticks on its next edge.
+			 */
+			inline bool isEnabled(const ClockDomain& d) const {
+				return d.enabled && (d.enable == none || this->netlist.getWord(d.enable) != typename Netlist<bit_width>::Word());
+			}
+
+			/**	\brief	Propagates the marked components until the combinational logic settles.
+			 */
+			void settle() {
+				while (!this->next.empty()) {
+					std::swap(this->current, this->next);
+
+					for(size_t i = this->current.pop(); i != DirtySet::npos; i = this->current.pop())
+						if (this->clockOf[i] == none) this->tick(i);
+				}
+			}
+
+		public:
+			/**	\brief	Default constructor
+			 *
+			 *	\param	netlist
+			 *		The Netlist to clock; its topology must not change afterwards.
+			 */
+			ClockScheduler(Netlist<bit_width>& netlist)
+				: netlist(netlist), clockOf(netlist.size(), none),
+				  current(netlist.size()), next(netlist.size()), time(0), evaluations(0), log(nullptr), ingress(nullptr), watchpoints(nullptr)
+			{}
+
+			/**	\brief	Enables the deterministic mode.
+			 *
+			 *	Every change is recorded in log and published in canonical
+			 *	(step, index) order at the end of each step().
+			 *
+			 *	\param	log
+			 *		The CommitLog to record in, or nullptr to disable (the default).
+			 */
+			inline void setLog(CommitLog<bit_width>* log) {
+				this->log = log;
+			}
+
+			/**	\brief	Takes writes from other threads out of ingress at the start of every step().
+			 *
+			 *	\param	ingress
+			 *		The Ingress to drain, or nullptr to disable (the default).
+			 */
+			inline void setIngress(Ingress<bit_width>* ingress) {
+				this->ingress = ingress;
+			}
+
+			/**	\brief	Checks watchpoints at the end of every step().
+			 *
+			 *	\param	watchpoints
+			 *		The Watchpoints to check, or nullptr to disable (the default).
+			 */
+			inline void setWatchpoints(Watchpoints<bit_width>* watchpoints) {
+				this->watchpoints = watchpoints;
+			}
+
+			/**	\brief	Adds a clock domain.
+			 *
+			 *	\param	period
+			 *		Time between two edges, must not be 0.
+			 *	\param	phase
+			 *		Time of the first edge.
+			 *
+			 *	\return	Domain
+			 *		Returns the id of the new domain.
+			 */
+			Domain addDomain(SimTime period, SimTime phase = 0) {
+				if (period == 0) throw std::invalid_argument("ClockScheduler: clock period must not be 0");
+
+				const ClockDomain d = { period, phase, std::vector<Index>(), 0, 0, true, none };
+				this->domains.push_back(d);
+
+				const Edge e = { phase, this->domains.size() - 1 };
+				this->upcoming.push(e);
+				return e.domain;
+			}
+
+			/**	\brief	Gets domain d.
+			 */
+			inline const ClockDomain& domain(Domain d) const {
+				return this->domains[d];
+			}
+
+			/**	\brief	Gates domain d in software: while disabled its edges skip all members.
+			 */
+			inline void setEnabled(Domain d, bool enabled) {
+				this->domains[d].enabled = enabled;
+			}
+
+			/**	\brief	Gates domain d by a signal: its edges only tick while component i is not all zero.
+			 *
+			 *	\param	i
+			 *		The enable component, or `ClockScheduler::none` to remove the gate.
+			 */
+			inline void setEnable(Domain d, size_t i) {
+				this->domains[d].enable = i;
+			}
+
+			/**	\brief	Gates domain d by the state of component c.
+			 */
+			inline void setEnable(Domain d, SynchrotronComponent<bit_width>& c) {
+				const size_t i = this->netlist.indexOf(&c);
+				if (i != Netlist<bit_width>::npos) this->setEnable(d, i);
+			}
+
+			/**	\brief	Gets the domain component i is clocked by, or `ClockScheduler::none`.
+			 */
+			inline Domain domainOf(size_t i) const {
+				return this->clockOf[i];
+			}
+
+			/**	\brief	Clocks component i by domain d, or makes it combinational with `none`.
+			 */
+			void subscribe(size_t i, Domain d) {
+				const Domain old = this->clockOf[i];
+				if (old == d) return;
+
+				if (old != none) {
+					std::vector<Index> &m = this->domains[old].members;
+					for(size_t k = 0; k < m.size(); k++) {
+						if (m[k] != i) continue;
+						m.erase(m.begin() + k);
+						break;
+					}
+				}
+
+				if (d != none) this->domains[d].members.push_back(Index(i));
+				this->clockOf[i] = d;
+			}
+
+			/**	\brief	Clocks component c by domain d.
+			 */
+			inline void subscribe(SynchrotronComponent<bit_width>& c, Domain d) {
+				const size_t i = this->netlist.indexOf(&c);
+				if (i != Netlist<bit_width>::npos) this->subscribe(i, d);
+			}
+
+			/**	\brief	Clocks the component h refers to by domain d.
+			 */
+			inline void subscribe(const Handle& h, Domain d) {
+				const size_t i = this->netlist.indexOf(h);
+				if (i != Netlist<bit_width>::npos) this->subscribe(i, d);
+			}
+
+			/**	\brief	Marks the outputs of component i, whose state was changed from outside, for the next step().
+			 */
+			inline void changed(size_t i) {
+				for(const Index *o = this->netlist.outputsBegin(i), *end = this->netlist.outputsEnd(i); o != end; ++o)
+					this->next.mark(*o);
+			}
+
+			/**	\brief	Gets the time of the last edge.
+			 */
+			inline SimTime now() const {
+				return this->time;
+			}
+
+			/**	\brief	Gets the time of the next edge, `never` without domains.
+			 */
+			inline SimTime nextEdge() const {
+				return this->upcoming.empty() ? never : this->upcoming.top().time;
+			}
+
+			/**	\brief	Advances to the next edge and ticks every enabled domain that has an edge then.
+			 *
+			 *	\return	size_t
+			 *		Returns the amount of components that were evaluated.
+			 */
+			size_t step() {
+				this->evaluations = 0;
+				if (this->upcoming.empty()) return 0;
+				if (this->log) this->log->lanes(1);
+
+				this->time = this->upcoming.top().time;
+				this->due.clear();
+
+				if (this->ingress)
+					this->ingress->drain(this->netlist, [this](size_t i) { this->changed(i); });
+
+				while (!this->upcoming.empty() && this->upcoming.top().time == this->time) {
+					Edge e = this->upcoming.top();
+					this->upcoming.pop();
+
+					ClockDomain &d = this->domains[e.domain];
+					if (this->isEnabled(d)) {
+						d.edges++;
+						this->due.push_back(e.domain);
+					} else {
+						d.gated++;
+					}
+
+					e.time = later(e.time, d.period);
+					if (e.time != never) this->upcoming.push(e);
+				}
+
+				// Two phases, so no register sees a state written on this edge
+				this->latched.clear();
+				for(Domain d : this->due)
+					for(Index i : this->domains[d].members)
+						this->latched.push_back(std::make_pair(i, this->netlist.nextWord(i)));
+
+				this->evaluations += this->latched.size();
+				for(auto& l : this->latched) {
+					if (!this->netlist.commit(l.first, l.second)) continue;
+
+					if (this->log) this->log->record(0, this->time, l.first, this->netlist.getState(l.first));
+					this->changed(l.first);
+				}
+
+				this->settle();
+				if (this->ingress) this->ingress->quiesced();
+				if (this->watchpoints) this->watchpoints->check();
+
+				if (this->log) this->log->publish();
+				return this->evaluations;
+			}
+
+			/**	\brief	Ticks every edge up to and including time t.
+			 *
+			 *	Stops early, at now(), when a watchpoint triggered.
+			 *
+			 *	\return	size_t
+			 *		Returns the amount of components that were evaluated.
+			 */
+			size_t run(SimTime t) {
+				size_t total = 0;
+
+				while (this->nextEdge() <= t && this->nextEdge() != never) {
+					total += this->step();
+					if (this->watchpoints && !this->watchpoints->hits().empty()) break;
+				}
+
+				return total;
+			}
+	};
+
+	template <size_t bit_width>
+	const typename ClockScheduler<bit_width>::Domain ClockScheduler<bit_width>::none;
+
+}
+
+#endif // SYNCHROTRONCLOCK_HPP
@@ -12,6 +12,8 @@
 #include <initializer_list>
 #include <mutex>
 
+#include "SynchrotronWord.hpp"
+
 namespace Synchrotron {
 
     /** \brief Mutex class to lock the current working thread.
@@ -32,6 +34,13 @@ namespace Synchrotron {
 			virtual void lock()				{ m_mutex.lock();	}
 			virtual void unlock()			{ m_mutex.unlock();	}
 
+			/**	\brief	Gets the creation index of this instance.
+			 *
+			 *	\return	size_t
+			 *		Returns the unique, monotonically increasing id used by `Mutex::compare`.
+			 */
+			inline size_t getIdx() const	{ return idx;		}
+
 			struct compare {
 				inline bool operator() (const Mutex* lhs, const Mutex* rhs) const {
 					return lhs->idx < rhs->idx;
@@ -62,11 +71,16 @@ namespace Synchrotron {
      */
 	template <size_t bit_width>
 	class SynchrotronComponent : public Mutex {
+		public:
+			/**	\brief	Native storage of the state, see StateWord.
+			 */
+			typedef typename StateWord<bit_width>::type Word;
+
 		protected:
 			/**	\brief
 			 *	The current internal state of bits in this component (default output).
 			 */
-			std::bitset<bit_width> state;
+			Word state;
 
 		private:
 			/**	\brief
@@ -119,7 +133,7 @@ namespace Synchrotron {
 			 *	\param	bit_width
 			 *		The size of the internal width of the bitset.
              */
-			SynchrotronComponent(size_t initial_value = 0) : state(initial_value) {}
+			SynchrotronComponent(size_t initial_value = 0) : state(StateWord<bit_width>::from(std::bitset<bit_width>(initial_value))) {}
 
 			/**	\brief **[Thread safe]**
 			 *	Copy constructor
@@ -215,7 +229,67 @@ namespace Synchrotron {
              *      Returns the internal bitset.
              */
 			inline std::bitset<bit_width> getState() const {
-				return this->state;
+				return StateWord<bit_width>::to(this->state);
+			}
+
+			/**	\brief	Sets this SynchrotronComponent's state without notifying any outputs.
+			 *
+			 *	\param	value
+			 *		The new internal bitset.
+			 */
+			inline void setState(const std::bitset<bit_width>& value) {
+				this->state = StateWord<bit_width>::from(value);
+			}
+
+			/**	\brief	Applies the component logic of a single input state onto acc.
+			 *
+			 *	Every propagation path (tick() as well as the engines working on a Netlist)
+			 *	folds inputs through this method, so the logic only lives in one place.
+			 *	It is applied to std::bitset as well as to the native Word.
+			 *
+			 *	\param	acc
+			 *		The accumulated state, starting from the current state.
+			 *	\param	input
+			 *		The state of one of the inputs.
+			 */
+			template <class State>
+			static inline void fold(State& acc, const State& input) {
+				// Change this line to change the logic applied on the states:
+				acc |= input;
+			}
+
+			/**	\brief	Computes the state tick() would produce, without committing it.
+			 *
+			 *	\return	std::bitset<bit_width>
+			 *		Returns the current state folded with all input states.
+			 */
+			inline std::bitset<bit_width> nextState() const {
+				return StateWord<bit_width>::to(this->nextWord());
+			}
+
+			/**	\brief	Computes the state tick() would produce, as a native Word.
+			 */
+			inline Word nextWord() const {
+				Word next = this->state;
+
+				for(auto& connection : this->signalInput) {
+					fold(next, connection->state);
+				}
+
+				StateWord<bit_width>::mask(next);
+				return next;
+			}
+
+			/**	\brief	Recomputes the state from the inputs, without emitting.
+			 *
+			 *	\return	bool
+			 *		Returns whether the state changed.
+			 */
+			inline bool evaluate() {
+				const Word next = this->nextWord();
+				const bool changed = (next != this->state);
+				this->state = next;
+				return changed;
 			}
 
 			/**	\brief	Gets the SynchrotronComponent's input connections.
@@ -325,16 +399,10 @@ namespace Synchrotron {
              */
 			virtual void tick() {
 				//LockBlock lock(this);
-				std::bitset<bit_width> prevState = this->state;
 
 				//std::cout << "Ticked\n";
-				for(auto& connection : this->signalInput) {
-					// Change this line to change the logic applied on the states:
-					this->state |= ((SynchrotronComponent*) connection)->getState();
-				}
-
 				// Directly emit changes to subscribers on change
-				if (prevState != this->state)
+				if (this->evaluate())
 					this->emit();
 			}
 
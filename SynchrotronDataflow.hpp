@@ -0,0 +1,267 @@
+/**
+*	Parallel dataflow (countdown) propagation over a Netlist.
+*/
+#ifndef SYNCHROTRONDATAFLOW_HPP
+#define SYNCHROTRONDATAFLOW_HPP
+
+#include "SynchrotronDirty.hpp"
+#include "SynchrotronNetlist.hpp"
+#include "SynchrotronThreadPool.hpp"
+#include "SynchrotronTrace.hpp"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace Synchrotron {
+
+	/** \brief
+	 *	DataflowExecutor propagates a stimulus through a Netlist without a global barrier.
+	 *
+	 *	Every component in the forward cone of the stimulus holds an atomic count of
+	 *	inputs that have not finished yet. A component is evaluated as soon as that
+	 *	count reaches zero, on whichever worker finished its last input,
+	 *	idle workers steal ready components from the others.
+	 *
+	 *	A component whose inputs all finished without changing is not evaluated,
+	 *	but still counts down its outputs. The result is identical to the recursive
+	 *	tick()/emit() propagation, with every component evaluated at most once.
+	 *	Components on a cycle never reach zero; they are finished sequentially afterwards.
+	 *
+	 *	With a CommitLog (setLog()) the changes of the parallel part are recorded as step 0,
+	 *	the sequential evaluations on cycles as steps 1, 2, ... in the order they happen.
+	 *
+	 *	\param	bit_width
+	 *		This template argument specifies the width of the internal bitset state.
+	 */
+	template <size_t bit_width>
+	class DataflowExecutor {
+		private:
+			Netlist<bit_width>	&netlist;
+			ThreadPool			&pool;
+
+			/**	\brief	Amount of unfinished inputs inside the current cone.
+			 */
+			std::unique_ptr<std::atomic<size_t>[]>	pending;
+
+			/**	\brief	Set when at least one finished input changed (or the component is a source).
+			 */
+			std::unique_ptr<std::atomic<bool>[]>	changed;
+
+			/**	\brief	Per component mark of the last wave that included it in its cone.
+			 */
+			std::vector<size_t>	inCone;
+			size_t				wave;
+
+			std::vector<size_t>	cone;
+			std::vector<Task>	roots;
+			std::atomic<size_t>	evaluated;
+
+			/**	\brief	Components on a cycle that still have to be ticked.
+			 */
+			DirtySet			stuck;
+
+			CommitLog<bit_width>	*log;
+
+			/**	\brief	Finishes component i: evaluates it if needed and counts down its outputs.
+			 */
+			static void process(void* ctx, size_t i, size_t worker) {
+				DataflowExecutor *self = static_cast<DataflowExecutor*>(ctx);
+				bool dirty = self->changed[i].load(std::memory_order_relaxed);
+
+				// Sources keep their forced change, others only change when they evaluate differently
+				if (self->pending[i].load(std::memory_order_relaxed) != npos) {
+					if (dirty) {
+						const bool changed = self->netlist.evaluate(i);
+						if (changed && self->log) self->log->record(worker, 0, i, self->netlist.getState(i));
+
+						dirty = changed || self->isSource(i);
+						self->evaluated.fetch_add(1, std::memory_order_relaxed);
+					}
+				}
+
+				for(const Index *o = self->netlist.outputsBegin(i), *end = self->netlist.outputsEnd(i); o != end; ++o) {
+					if (dirty) self->changed[*o].store(true, std::memory_order_relaxed);
+
+					if (self->pending[*o].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+						Task t = { &DataflowExecutor::process, self, *o };
+						self->pool.spawn(worker, t);
+					}
+				}
+			}
+
+			static const size_t npos = size_t(-1);
+
+			/**	\brief	Marks components that were stimulated this wave.
+			 */
+			std::vector<size_t> sourceWave;
+
+			inline bool isSource(size_t i) const {
+				return this->sourceWave[i] == this->wave;
+			}
+
+			inline void markOutputs(size_t i) {
+				for(const Index *o = this->netlist.outputsBegin(i), *end = this->netlist.outputsEnd(i); o != end; ++o)
+					this->stuck.mark(*o);
+			}
+
+		public:
+			/**	\brief	Default constructor
+			 *
+			 *	\param	netlist
+			 *		The Netlist to propagate through; its topology must not change afterwards.
+			 *	\param	pool
+			 *		The workers to use.
+			 */
+			DataflowExecutor(Netlist<bit_width>& netlist, ThreadPool& pool)
+				: netlist(netlist), pool(pool),
+				  pending(new std::atomic<size_t>[netlist.size()]),
+				  changed(new std::atomic<bool>[netlist.size()]),
+				  inCone(netlist.size(), 0), wave(0), evaluated(0), stuck(netlist.size()), log(nullptr),
+				  sourceWave(netlist.size(), 0)
+			{}
+
+			/**	\brief	Enables the deterministic mode.
+			 *
+			 *	Every change is recorded in log and published in canonical
+			 *	(step, index) order at the end of each propagate().
+			 *
+			 *	\param	log
+			 *		The CommitLog to record in, or nullptr to disable (the default).
+			 */
+			inline void setLog(CommitLog<bit_width>* log) {
+				this->log = log;
+			}
+
+			/**	\brief	Propagates the changes of sources through the Netlist.
+			 *
+			 *	The sources must already have their new working state (Netlist::setState()).
+			 *
+			 *	\param	sources
+			 *		Indices of the components whose state changed.
+			 *	\param	count
+			 *		The amount of sources.
+			 *
+			 *	\return	size_t
+			 *		Returns the amount of components that were evaluated.
+			 */
+			size_t propagate(const size_t* sources, size_t count) {
+				this->wave++;
+				this->cone.clear();
+				this->roots.clear();
+				this->evaluated.store(0, std::memory_order_relaxed);
+				if (this->log) this->log->lanes(this->pool.size());
+
+				// 1. Collect the forward cone of all sources
+				for(const size_t *s = sources; s != sources + count; ++s) {
+					this->sourceWave[*s] = this->wave;
+					if (this->inCone[*s] != this->wave) {
+						this->inCone[*s] = this->wave;
+						this->cone.push_back(*s);
+					}
+				}
+
+				for(size_t k = 0; k < this->cone.size(); k++) {
+					const size_t i = this->cone[k];
+					this->pending[i].store(0, std::memory_order_relaxed);
+					this->changed[i].store(this->isSource(i), std::memory_order_relaxed);
+
+					for(const Index *o = this->netlist.outputsBegin(i), *end = this->netlist.outputsEnd(i); o != end; ++o) {
+						if (this->inCone[*o] != this->wave) {
+							this->inCone[*o] = this->wave;
+							this->cone.push_back(*o);
+						}
+					}
+				}
+
+				// 2. Count the inputs of every cone member that lie inside the cone
+				for(size_t i : this->cone)
+					for(const Index *o = this->netlist.outputsBegin(i), *end = this->netlist.outputsEnd(i); o != end; ++o)
+						this->pending[*o].fetch_add(1, std::memory_order_relaxed);
+
+				// 3. Sources without pending inputs are ready; they need no evaluation
+				for(const size_t *s = sources; s != sources + count; ++s) {
+					if (this->pending[*s].load(std::memory_order_relaxed) == 0) {
+						this->pending[*s].store(npos, std::memory_order_relaxed);
+						Task t = { &DataflowExecutor::process, this, *s };
+						this->roots.push_back(t);
+					}
+				}
+
+				this->pool.execute(this->roots.data(), this->roots.size());
+
+				// 4. Whatever is still pending lies on (or behind) a cycle: settle it sequentially,
+				//	  ticking only components that have a changed input, like emit() would
+				for(size_t i : this->cone) {
+					const size_t p = this->pending[i].load(std::memory_order_relaxed);
+					if (p == 0 || p == npos || !this->changed[i].load(std::memory_order_relaxed)) continue;
+
+					if (this->isSource(i))
+						this->markOutputs(i);
+					else
+						this->stuck.mark(i);
+				}
+
+				for(uint64_t step = 1; !this->stuck.empty(); step++) {
+					const size_t i = this->stuck.pop();
+
+					this->evaluated.fetch_add(1, std::memory_order_relaxed);
+					if (this->netlist.evaluate(i)) {
+						if (this->log) this->log->record(0, step, i, this->netlist.getState(i));
+						this->markOutputs(i);
+					}
+				}
+
+				if (this->log) this->log->publish();
+
+				return this->evaluated.load(std::memory_order_relaxed);
+			}
+
+			/**	\brief	Propagates the changes of sources through the Netlist.
+			 *
+			 *	\param	sources
+			 *		Indices of the components whose state changed.
+			 *
+			 *	\return	size_t
+			 *		Returns the amount of components that were evaluated.
+			 */
+			inline size_t propagate(const std::vector<size_t>& sources) {
+				return this->propagate(sources.data(), sources.size());
+			}
+
+			/**	\brief	Sets a new state on component c and propagates it.
+			 *
+			 *	Parallel counterpart of `c.setState(value); c.emit();`,
+			 *	working on the Netlist states (see Netlist::store()).
+			 *
+			 *	\return	size_t
+			 *		Returns the amount of components that were evaluated.
+			 */
+			size_t emit(SynchrotronComponent<bit_width>& c, const std::bitset<bit_width>& value) {
+				const size_t i = this->netlist.indexOf(&c);
+				if (i == Netlist<bit_width>::npos) return 0;
+
+				this->netlist.setState(i, value);
+				return this->propagate(&i, 1);
+			}
+
+			/**	\brief	Sets a new state on the component h refers to and propagates it.
+			 *
+			 *	\return	size_t
+			 *		Returns the amount of components that were evaluated, 0 when h is stale.
+			 */
+			size_t emit(const Handle& h, const std::bitset<bit_width>& value) {
+				const size_t i = this->netlist.indexOf(h);
+				if (i == Netlist<bit_width>::npos) return 0;
+
+				this->netlist.setState(i, value);
+				return this->propagate(&i, 1);
+			}
+	};
+
+	template <size_t bit_width>
+	const size_t DataflowExecutor<bit_width>::npos;
+
+}
+
+#endif // SYNCHROTRONDATAFLOW_HPP
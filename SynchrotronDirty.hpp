@@ -0,0 +1,157 @@
+/**
+*	Hierarchical bitmap of components that need evaluation.
+*/
+#ifndef SYNCHROTRONDIRTY_HPP
+#define SYNCHROTRONDIRTY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace Synchrotron {
+
+	/**	\brief	Gets the position of the lowest set bit of w, which must not be 0.
+	 */
+	inline size_t lowestBit(uint64_t w) {
+#if defined(_MSC_VER)
+		unsigned long k;
+		_BitScanForward64(&k, w);
+		return size_t(k);
+#else
+		return size_t(__builtin_ctzll(w));
+#endif
+	}
+
+	/** \brief
+	 *	DirtySet is a set of component indices stored as a three level bitmap.
+	 *
+	 *	Bit i of `leaf` marks index i, bit k of `middle` marks a non-zero leaf word k
+	 *	and bit k of `top` a non-zero middle word k. Finding the lowest marked index
+	 *	takes one scan over `top` (one word per 262144 indices) and a count trailing
+	 *	zeros on each level. Marking is idempotent, so a component that is ticked
+	 *	by several inputs is evaluated once.
+	 *
+	 *	The bitmap is allocated once by the constructor (or resize()), marking and
+	 *	popping never allocate.
+	 */
+	class DirtySet {
+		private:
+			std::vector<uint64_t>	leaf, middle, top;
+			size_t					marked;
+
+		public:
+			/**	\brief	Index returned by first() and pop() when the set is empty.
+			 */
+			static const size_t npos = size_t(-1);
+
+			/**	\brief	Default constructor
+			 *
+			 *	\param	n
+			 *		The amount of indices, 0 .. n - 1.
+			 */
+			DirtySet(size_t n = 0) : marked(0) {
+				this->resize(n);
+			}
+
+			/**	\brief	Sets the amount of indices, clearing the set.
+			 */
+			void resize(size_t n) {
+				this->leaf.assign((n + 63) / 64, 0);
+				this->middle.assign((this->leaf.size() + 63) / 64, 0);
+				this->top.assign((this->middle.size() + 63) / 64, 0);
+				this->marked = 0;
+			}
+
+			/**	\brief	Gets the amount of indices that can be marked.
+			 */
+			inline size_t capacity() const {
+				return this->leaf.size() * 64;
+			}
+
+			/**	\brief	Gets the amount of marked indices.
+			 */
+			inline size_t count() const {
+				return this->marked;
+			}
+
+			inline bool empty() const {
+				return this->marked == 0;
+			}
+
+			/**	\brief	Gets whether index i is marked.
+			 */
+			inline bool test(size_t i) const {
+				return (this->leaf[i >> 6] >> (i & 63)) & 1;
+			}
+
+			/**	\brief	Marks index i.
+			 *
+			 *	\return	bool
+			 *		Returns whether i was not marked yet.
+			 */
+			inline bool mark(size_t i) {
+				uint64_t &word = this->leaf[i >> 6];
+				const uint64_t bit = uint64_t(1) << (i & 63);
+				if (word & bit) return false;
+
+				word |= bit;
+				this->middle[i >> 12]	|= uint64_t(1) << ((i >> 6) & 63);
+				this->top[i >> 18]		|= uint64_t(1) << ((i >> 12) & 63);
+				this->marked++;
+				return true;
+			}
+
+			/**	\brief	Unmarks index i.
+			 */
+			inline void reset(size_t i) {
+				uint64_t &word = this->leaf[i >> 6];
+				const uint64_t bit = uint64_t(1) << (i & 63);
+				if (!(word & bit)) return;
+
+				this->marked--;
+				if ((word &= ~bit)) return;
+				if ((this->middle[i >> 12] &= ~(uint64_t(1) << ((i >> 6) & 63)))) return;
+				this->top[i >> 18] &= ~(uint64_t(1) << ((i >> 12) & 63));
+			}
+
+			/**	\brief	Gets the lowest marked index.
+			 *
+			 *	\return	size_t
+			 *		Returns the index, or `DirtySet::npos` when the set is empty.
+			 */
+			inline size_t first() const {
+				if (this->marked == 0) return npos;
+
+				size_t t = 0;
+				while (!this->top[t]) t++;
+
+				const size_t m = t * 64 + lowestBit(this->top[t]);
+				const size_t l = m * 64 + lowestBit(this->middle[m]);
+				return l * 64 + lowestBit(this->leaf[l]);
+			}
+
+			/**	\brief	Unmarks and returns the lowest marked index.
+			 *
+			 *	\return	size_t
+			 *		Returns the index, or `DirtySet::npos` when the set is empty.
+			 */
+			inline size_t pop() {
+				const size_t i = this->first();
+				if (i != npos) this->reset(i);
+				return i;
+			}
+
+			/**	\brief	Unmarks everything, in time proportional to count().
+			 */
+			void clear() {
+				while (this->marked) this->pop();
+			}
+	};
+
+}
+
+#endif // SYNCHROTRONDIRTY_HPP
@@ -0,0 +1,62 @@
+/**
+*	Timestamped events shared by the discrete-event engines.
+*/
+#ifndef SYNCHROTRONEVENT_HPP
+#define SYNCHROTRONEVENT_HPP
+
+#include <bitset>
+#include <cstdint>
+
+namespace Synchrotron {
+
+	/**	\brief	Simulated time, in gate delay units.
+	 */
+	typedef uint64_t SimTime;
+
+	/**	\brief	A time that is never reached.
+	 */
+	const SimTime never = SimTime(-1);
+
+	/**	\brief	Adds a delay to t, saturating at `never`.
+	 */
+	inline SimTime later(SimTime t, SimTime delay) {
+		return (t > never - delay) ? never : t + delay;
+	}
+
+	/** \brief
+	 *	A timestamped event on component `index`.
+	 *	*	**Update**: the (output) state of `index` becomes `value` at `time`.
+	 *	*	**Evaluate**: `index` recomputes its state from its inputs at `time`.
+	 *
+	 *	Events order by (time, kind, index, value): all updates of a time step are applied
+	 *	before any component of that step evaluates, and ties never depend on
+	 *	insertion order.
+	 *
+	 *	\param	bit_width
+	 *		This template argument specifies the width of the internal bitset state.
+	 */
+	template <size_t bit_width>
+	struct Event {
+		enum Kind { Update = 0, Evaluate = 1 };
+
+		SimTime					time;
+		size_t					kind;
+		size_t					index;
+		std::bitset<bit_width>	value;
+
+		inline bool operator> (const Event& other) const {
+			if (this->time != other.time) return this->time > other.time;
+			if (this->kind != other.kind) return this->kind > other.kind;
+			if (this->index != other.index) return this->index > other.index;
+
+			// Two updates of one component at the same time: settle on the value
+			for(size_t b = bit_width; b--;)
+				if (this->value[b] != other.value[b]) return this->value[b];
+
+			return false;
+		}
+	};
+
+}
+
+#endif // SYNCHROTRONEVENT_HPP
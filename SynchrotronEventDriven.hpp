@@ -0,0 +1,311 @@
+/**
+*	Sequential event-driven propagation over a Netlist, scheduled through dirty bitmaps.
+*/
+#ifndef SYNCHROTRONEVENTDRIVEN_HPP
+#define SYNCHROTRONEVENTDRIVEN_HPP
+
+#include "SynchrotronDirty.hpp"
+#include "SynchrotronIngress.hpp"
+#include "SynchrotronNetlist.hpp"
+#include "SynchrotronStop.hpp"
+#include "SynchrotronTrace.hpp"
+
+#include <chrono>
+#include <utility>
+#include <vector>
+
+namespace Synchrotron {
+
+	/** \brief
+	 *	EventDrivenEngine only evaluates components that have an input which changed.
+	 *
+	 *	Propagation runs in waves: every component marked in the current wave is
+	 *	evaluated once, in index order, and the outputs of those that changed are
+	 *	marked for the next wave. Both waves are DirtySets allocated up front, so
+	 *	a component ticked by several inputs is evaluated once per wave and
+	 *	propagation itself never allocates.
+	 *
+	 *	The final states equal those of the recursive tick()/emit() propagation.
+	 *	propagate(const Budget&) stops early once its budget is spent and resumes
+	 *	at the same component on the next call, so a sliced run evaluates exactly
+	 *	what an uninterrupted one does, in the same order. A StopToken in the
+	 *	budget stops it the same way, from any thread; the Netlist is then left
+	 *	between two evaluations, ready to resume() or to discard() the rest.
+	 *
+	 *	Writes from other threads arrive through an Ingress (setIngress()), which
+	 *	is drained at every wave boundary: they join the next wave.
+	 *
+	 *	With a CommitLog (setLog()) the changes of wave w (counting from 1) are
+	 *	recorded as step w.
+	 *
+	 *	\param	bit_width
+	 *		This template argument specifies the width of the internal bitset state.
+	 */
+	template <size_t bit_width>
+	class EventDrivenEngine {
+		public:
+			/**	\brief	Limits the work of a single propagate(const Budget&) call.
+			 */
+			struct Budget {
+				size_t						events;		// Maximum amount of evaluations, 0 for no limit
+				std::chrono::nanoseconds	time;		// Maximum wall clock time, 0 for no limit
+				StopToken					stop;		// Stops when requested, never by default
+			};
+
+			enum Status { Settled, Suspended, Stopped };
+
+		private:
+			Netlist<bit_width>	&netlist;
+
+			/**	\brief	Components to evaluate in this wave and in the next one.
+			 */
+			DirtySet			current, next;
+
+			/**	\brief	The current wave, 0 when settled.
+			 */
+			uint64_t			wave;
+
+			/**	\brief	Evaluations done by the last propagate() call, and how many of them changed a state.
+			 */
+			size_t				evaluations, changes;
+
+			/**	\brief	Components the last propagate() call changed, each once however often cycles changed it.
+			 */
+			DirtySet			touched;
+
+			CommitLog<bit_width>	*log;
+			Ingress<bit_width>		*ingress;
+
+			/**	\brief	The clock and the StopToken are polled once per this many evaluations.
+			 */
+			static const size_t pollInterval = 64;
+
+			/**	\brief	Marks all outputs of component i for the next wave.
+			 */
+			inline void markOutputs(size_t i) {
+				for(const Index *o = this->netlist.outputsBegin(i), *end = this->netlist.outputsEnd(i); o != end; ++o)
+					this->next.mark(*o);
+			}
+
+		public:
+			/**	\brief	Default constructor
+			 *
+			 *	\param	netlist
+			 *		The Netlist to propagate through; its topology must not change afterwards.
+			 */
+			EventDrivenEngine(Netlist<bit_width>& netlist)
+				: netlist(netlist), current(netlist.size()), next(netlist.size()),
+				  wave(0), evaluations(0), changes(0), touched(netlist.size()), log(nullptr), ingress(nullptr)
+			{}
+
+			/**	\brief	Enables the deterministic mode.
+			 *
+			 *	Every change is recorded in log and published in canonical
+			 *	(step, index) order at the end of each propagate().
+			 *
+			 *	\param	log
+			 *		The CommitLog to record in, or nullptr to disable (the default).
+			 */
+			inline void setLog(CommitLog<bit_width>* log) {
+				this->log = log;
+			}
+
+			/**	\brief	Takes writes from other threads out of ingress at every wave boundary.
+			 *
+			 *	\param	ingress
+			 *		The Ingress to drain, or nullptr to disable (the default).
+			 */
+			inline void setIngress(Ingress<bit_width>* ingress) {
+				this->ingress = ingress;
+			}
+
+			/**	\brief	Schedules the outputs of component i, whose state changed, for the next propagate().
+			 */
+			inline void changed(size_t i) {
+				this->markOutputs(i);
+			}
+
+			/**	\brief	Schedules component i itself for evaluation in the next propagate().
+			 */
+			inline void schedule(size_t i) {
+				this->next.mark(i);
+			}
+
+			/**	\brief	Gets whether nothing is scheduled, nor left over from a suspended propagate().
+			 */
+			inline bool idle() const {
+				return this->current.empty() && this->next.empty();
+			}
+
+			/**	\brief	Gets the amount of components evaluated by the last propagate() call.
+			 */
+			inline size_t evaluated() const {
+				return this->evaluations;
+			}
+
+			/**	\brief	Gets the amount of evaluations of the last propagate() call that changed a state.
+			 */
+			inline size_t modified() const {
+				return this->changes;
+			}
+
+			/**	\brief	Gets the amount of components the last propagate() call changed, each counted once.
+			 */
+			inline size_t changedComponents() const {
+				return this->touched.count();
+			}
+
+			/**	\brief	Evaluates scheduled components wave by wave until nothing changes or the budget is spent.
+			 *
+			 *	Components scheduled while suspended join the wave after the current one.
+			 *
+			 *	\param	budget
+			 *		The maximum amount of work for this call.
+			 *
+			 *	\return	Status
+			 *		Returns `Settled` when nothing is left to do, `Suspended` when the
+			 *		budget ran out and `Stopped` when budget.stop was requested;
+			 *		in both latter cases a next call continues where this one stopped.
+			 */
+			Status propagate(const Budget& budget) {
+				typedef std::chrono::steady_clock Clock;
+				const Clock::time_point start = Clock::now();
+				Status status = Suspended;
+
+				if (this->log) this->log->lanes(1);
+				this->evaluations	= 0;
+				this->changes		= 0;
+				this->touched.clear();
+
+				for(;;) {
+					if (this->current.empty()) {
+						if (this->ingress)
+							this->ingress->drain(this->netlist, [this](size_t i) { this->markOutputs(i); });
+
+						if (this->next.empty()) {
+							if (this->ingress) this->ingress->quiesced();
+
+							this->wave = 0;
+							status = Settled;
+							break;
+						}
+
+						std::swap(this->current, this->next);
+						this->wave++;
+					}
+
+					if (budget.events && this->evaluations == budget.events) break;
+					if (this->evaluations % pollInterval == 0) {
+						if (budget.stop.stopRequested()) {
+							status = Stopped;
+							break;
+						}
+						if (budget.time.count() && this->evaluations && Clock::now() - start >= budget.time) break;
+					}
+
+					const size_t i = this->current.pop();
+					this->evaluations++;
+					if (!this->netlist.evaluate(i)) continue;
+
+					this->changes++;
+					this->touched.mark(i);
+					if (this->log) this->log->record(0, this->wave, i, this->netlist.getState(i));
+					this->markOutputs(i);
+				}
+
+				if (this->log) this->log->publish();
+				return status;
+			}
+
+			/**	\brief	Evaluates scheduled components wave by wave until nothing changes anymore.
+			 *
+			 *	\return	size_t
+			 *		Returns the amount of components that were evaluated.
+			 */
+			size_t propagate() {
+				const Budget unlimited = { 0, std::chrono::nanoseconds(0), StopToken() };
+				this->propagate(unlimited);
+				return this->evaluations;
+			}
+
+			/**	\brief	Continues a suspended or stopped propagation until stop is requested.
+			 *
+			 *	\return	Status
+			 *		Returns `Settled` or `Stopped`.
+			 */
+			inline Status resume(const StopToken& stop = StopToken()) {
+				const Budget budget = { 0, std::chrono::nanoseconds(0), stop };
+				return this->propagate(budget);
+			}
+
+			/**	\brief	Drops all scheduled work, typically after a `Stopped` propagation.
+			 *
+			 *	States evaluated so far are kept. Writes already drained from the Ingress
+			 *	settle here, so their writers stop waiting although their propagation was
+			 *	cut short; writes still queued are applied by the next propagation.
+			 *
+			 *	There is no rollback of its own: Netlist::load() restores the states the
+			 *	components hold, which are those of the last Netlist::store() (or of the
+			 *	construction of the Netlist). A caller that may roll back has to store()
+			 *	before the run it may discard.
+			 */
+			void discard() {
+				this->current.clear();
+				this->next.clear();
+				this->wave = 0;
+				if (this->ingress) this->ingress->quiesced();
+			}
+
+			/**	\brief	Propagates the changes of sources through the Netlist.
+			 *
+			 *	The sources must already have their new working state (Netlist::setState()).
+			 *
+			 *	\param	sources
+			 *		Indices of the components whose state changed.
+			 *
+			 *	\return	size_t
+			 *		Returns the amount of components that were evaluated.
+			 */
+			size_t propagate(const std::vector<size_t>& sources) {
+				for(size_t s : sources) this->markOutputs(s);
+				return this->propagate();
+			}
+
+			/**	\brief	Sets a new state on component c and propagates it.
+			 *
+			 *	Counterpart of `c.setState(value); c.emit();`,
+			 *	working on the Netlist states (see Netlist::store()).
+			 *
+			 *	\return	size_t
+			 *		Returns the amount of components that were evaluated.
+			 */
+			size_t emit(SynchrotronComponent<bit_width>& c, const std::bitset<bit_width>& value) {
+				const size_t i = this->netlist.indexOf(&c);
+				if (i == Netlist<bit_width>::npos) return 0;
+
+				this->netlist.setState(i, value);
+				this->markOutputs(i);
+				return this->propagate();
+			}
+
+			/**	\brief	Sets a new state on the component h refers to and propagates it.
+			 *
+			 *	\return	size_t
+			 *		Returns the amount of components that were evaluated, 0 when h is stale.
+			 */
+			size_t emit(const Handle& h, const std::bitset<bit_width>& value) {
+				const size_t i = this->netlist.indexOf(h);
+				if (i == Netlist<bit_width>::npos) return 0;
+
+				this->netlist.setState(i, value);
+				this->markOutputs(i);
+				return this->propagate();
+			}
+	};
+
+	template <size_t bit_width>
+	const size_t EventDrivenEngine<bit_width>::pollInterval;
+
+}
+
+#endif // SYNCHROTRONEVENTDRIVEN_HPP
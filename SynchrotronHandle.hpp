@@ -0,0 +1,161 @@
+/**
+*	Generational handles to relocatable, densely stored items.
+*/
+#ifndef SYNCHROTRONHANDLE_HPP
+#define SYNCHROTRONHANDLE_HPP
+
+#include <cstdint>
+#include <vector>
+
+namespace Synchrotron {
+
+	/**	\brief	Dense 32-bit index, used for components and connections.
+	 */
+	typedef uint32_t Index;
+
+	/** \brief
+	 *	Stable reference to an item of a SlotMap.
+	 *
+	 *	`slot` never changes while the item lives, wherever the item itself is moved;
+	 *	`generation` tells a handle to an erased item apart from one to its successor.
+	 */
+	struct Handle {
+		Index		slot;
+		uint32_t	generation;
+
+		inline bool operator== (const Handle& other) const {
+			return this->slot == other.slot && this->generation == other.generation;
+		}
+
+		inline bool operator!= (const Handle& other) const {
+			return !(*this == other);
+		}
+	};
+
+	/** \brief
+	 *	SlotMap maps Handles to the current dense position of their item.
+	 *
+	 *	The owner keeps the items in its own (dense) arrays and reports every
+	 *	move here; a Handle stays valid across moves and becomes detectably
+	 *	stale once its item is erased, even when the slot is reused.
+	 */
+	class SlotMap {
+		private:
+			struct Slot {
+				Index		dense;		// Position of the item, or the next free slot
+				uint32_t	generation;
+			};
+
+			std::vector<Slot>	slots;
+			std::vector<Index>	slotOf;		// Dense position -> slot
+			Index				freeSlot;
+
+		public:
+			/**	\brief	Position returned by find() for stale handles.
+			 */
+			static const Index npos = Index(-1);
+
+			/**	\brief	Default constructor
+			 */
+			SlotMap() : freeSlot(npos) {}
+
+			/**	\brief	Gets the amount of live items.
+			 */
+			inline size_t size() const {
+				return this->slotOf.size();
+			}
+
+			/**	\brief	Adds an item at the next dense position.
+			 *
+			 *	\return	Handle
+			 *		Returns the handle of the new item.
+			 */
+			Handle push() {
+				Index s = this->freeSlot;
+
+				if (s == npos) {
+					s = Index(this->slots.size());
+					const Slot fresh = { 0, 0 };
+					this->slots.push_back(fresh);
+				} else {
+					this->freeSlot = this->slots[s].dense;
+				}
+
+				this->slots[s].dense = Index(this->slotOf.size());
+				this->slotOf.push_back(s);
+
+				const Handle h = { s, this->slots[s].generation };
+				return h;
+			}
+
+			/**	\brief	Gets the handle of the item at dense position i.
+			 */
+			inline Handle handle(size_t i) const {
+				const Index s = this->slotOf[i];
+				const Handle h = { s, this->slots[s].generation };
+				return h;
+			}
+
+			/**	\brief	Gets whether h still refers to a live item.
+			 */
+			inline bool valid(const Handle& h) const {
+				return h.slot < this->slots.size() && this->slots[h.slot].generation == h.generation;
+			}
+
+			/**	\brief	Gets the dense position of the item h refers to.
+			 *
+			 *	\return	Index
+			 *		Returns the position, or `SlotMap::npos` when h is stale.
+			 */
+			inline Index find(const Handle& h) const {
+				if (!this->valid(h)) return npos;
+				return this->slots[h.slot].dense;
+			}
+
+			/**	\brief	Erases the item at dense position i; the items after it move down by one.
+			 */
+			void erase(size_t i) {
+				const Index s = this->slotOf[i];
+
+				this->slots[s].generation++;
+				this->slots[s].dense = this->freeSlot;
+				this->freeSlot = s;
+
+				this->slotOf.erase(this->slotOf.begin() + i);
+				for(size_t k = i; k < this->slotOf.size(); k++)
+					this->slots[this->slotOf[k]].dense = Index(k);
+			}
+
+			/**	\brief	Gets the amount of heap memory held, in bytes.
+			 */
+			inline size_t bytes() const {
+				return this->slots.capacity() * sizeof(Slot) + this->slotOf.capacity() * sizeof(Index);
+			}
+
+			/**	\brief	Releases unused capacity. Erased slots are kept, their generation is still needed.
+			 */
+			void shrink() {
+				std::vector<Slot>(this->slots).swap(this->slots);
+				std::vector<Index>(this->slotOf).swap(this->slotOf);
+			}
+
+			/**	\brief	Moves every item from dense position i to position to[i].
+			 *
+			 *	\param	to
+			 *		A permutation of 0 .. size() - 1.
+			 */
+			void permute(const std::vector<Index>& to) {
+				std::vector<Index> moved(this->slotOf.size());
+
+				for(size_t i = 0; i < this->slotOf.size(); i++) {
+					moved[to[i]] = this->slotOf[i];
+					this->slots[this->slotOf[i]].dense = to[i];
+				}
+
+				this->slotOf.swap(moved);
+			}
+	};
+
+}
+
+#endif // SYNCHROTRONHANDLE_HPP
@@ -0,0 +1,173 @@
+/**
+*	Depth limited recursive propagation over a Netlist, spilling deep cones to a queue.
+*/
+#ifndef SYNCHROTRONHYBRID_HPP
+#define SYNCHROTRONHYBRID_HPP
+
+#include "SynchrotronDirty.hpp"
+#include "SynchrotronNetlist.hpp"
+#include "SynchrotronTrace.hpp"
+
+#include <vector>
+
+namespace Synchrotron {
+
+	/** \brief
+	 *	HybridEngine propagates like the recursive tick()/emit() of the components,
+	 *	but bounds the recursion depth.
+	 *
+	 *	Shallow cones are handled entirely by recursion, without any queue overhead.
+	 *	Outputs reached at the depth limit are marked in a DirtySet instead, and
+	 *	ticked from there (recursing again from depth 0) once the recursion unwound.
+	 *	Arbitrarily deep chains therefore use a bounded amount of stack, and
+	 *	the final states still equal those of tick()/emit().
+	 *
+	 *	With a CommitLog (setLog()) the n-th change of a propagate() is recorded as step n.
+	 *
+	 *	\param	bit_width
+	 *		This template argument specifies the width of the internal bitset state.
+	 */
+	template <size_t bit_width>
+	class HybridEngine {
+		private:
+			Netlist<bit_width>	&netlist;
+
+			/**	\brief	Components ticked at the depth limit, waiting for the recursion to unwind.
+			 */
+			DirtySet			spill;
+			size_t				limit;
+
+			size_t				evaluations;
+			uint64_t			changes;
+
+			CommitLog<bit_width>	*log;
+
+			/**	\brief	Ticks component i, depth calls below the stimulus.
+			 */
+			void tick(size_t i, size_t depth) {
+				this->evaluations++;
+				if (!this->netlist.evaluate(i)) return;
+
+				if (this->log) this->log->record(0, this->changes, i, this->netlist.getState(i));
+				this->changes++;
+				this->fanOut(i, depth);
+			}
+
+			/**	\brief	Ticks all outputs of component i, or spills them at the depth limit.
+			 */
+			void fanOut(size_t i, size_t depth) {
+				for(const Index *o = this->netlist.outputsBegin(i), *end = this->netlist.outputsEnd(i); o != end; ++o) {
+					if (depth < this->limit)
+						this->tick(*o, depth + 1);
+					else
+						this->spill.mark(*o);
+				}
+			}
+
+		public:
+			/**	\brief	Default constructor
+			 *
+			 *	\param	netlist
+			 *		The Netlist to propagate through; its topology must not change afterwards.
+			 *	\param	depth
+			 *		The maximum recursion depth, 0 makes the engine purely iterative.
+			 */
+			HybridEngine(Netlist<bit_width>& netlist, size_t depth = 256)
+				: netlist(netlist), spill(netlist.size()), limit(depth), evaluations(0), changes(0), log(nullptr)
+			{}
+
+			/**	\brief	Enables the deterministic mode.
+			 *
+			 *	Every change is recorded in log and published at the end of each propagate().
+			 *
+			 *	\param	log
+			 *		The CommitLog to record in, or nullptr to disable (the default).
+			 */
+			inline void setLog(CommitLog<bit_width>* log) {
+				this->log = log;
+			}
+
+			/**	\brief	Gets the maximum recursion depth.
+			 */
+			inline size_t depth() const {
+				return this->limit;
+			}
+
+			/**	\brief	Sets the maximum recursion depth, 0 makes the engine purely iterative.
+			 */
+			inline void setDepth(size_t depth) {
+				this->limit = depth;
+			}
+
+			/**	\brief	Propagates the changes of sources through the Netlist.
+			 *
+			 *	The sources must already have their new working state (Netlist::setState()).
+			 *
+			 *	\param	sources
+			 *		Indices of the components whose state changed.
+			 *	\param	count
+			 *		The amount of sources.
+			 *
+			 *	\return	size_t
+			 *		Returns the amount of components that were evaluated.
+			 */
+			size_t propagate(const size_t* sources, size_t count) {
+				this->evaluations	= 0;
+				this->changes		= 0;
+				if (this->log) this->log->lanes(1);
+
+				for(const size_t *s = sources; s != sources + count; ++s)
+					this->fanOut(*s, 0);
+
+				while (!this->spill.empty())
+					this->tick(this->spill.pop(), 0);
+
+				if (this->log) this->log->publish();
+				return this->evaluations;
+			}
+
+			/**	\brief	Propagates the changes of sources through the Netlist.
+			 *
+			 *	\param	sources
+			 *		Indices of the components whose state changed.
+			 *
+			 *	\return	size_t
+			 *		Returns the amount of components that were evaluated.
+			 */
+			inline size_t propagate(const std::vector<size_t>& sources) {
+				return this->propagate(sources.data(), sources.size());
+			}
+
+			/**	\brief	Sets a new state on component c and propagates it.
+			 *
+			 *	Counterpart of `c.setState(value); c.emit();`,
+			 *	working on the Netlist states (see Netlist::store()).
+			 *
+			 *	\return	size_t
+			 *		Returns the amount of components that were evaluated.
+			 */
+			size_t emit(SynchrotronComponent<bit_width>& c, const std::bitset<bit_width>& value) {
+				const size_t i = this->netlist.indexOf(&c);
+				if (i == Netlist<bit_width>::npos) return 0;
+
+				this->netlist.setState(i, value);
+				return this->propagate(&i, 1);
+			}
+
+			/**	\brief	Sets a new state on the component h refers to and propagates it.
+			 *
+			 *	\return	size_t
+			 *		Returns the amount of components that were evaluated, 0 when h is stale.
+			 */
+			size_t emit(const Handle& h, const std::bitset<bit_width>& value) {
+				const size_t i = this->netlist.indexOf(h);
+				if (i == Netlist<bit_width>::npos) return 0;
+
+				this->netlist.setState(i, value);
+				return this->propagate(&i, 1);
+			}
+	};
+
+}
+
+#endif // SYNCHROTRONHYBRID_HPP
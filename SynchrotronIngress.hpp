@@ -0,0 +1,162 @@
+/**
+*	Lock-free queue of state writes from other threads into a running simulation.
+*/
+#ifndef SYNCHROTRONINGRESS_HPP
+#define SYNCHROTRONINGRESS_HPP
+
+#include "SynchrotronChannel.hpp"
+#include "SynchrotronNetlist.hpp"
+#include "SynchrotronSettlement.hpp"
+
+#include <atomic>
+
+namespace Synchrotron {
+
+	/** \brief
+	 *	Ingress collects `(component, value)` writes from any amount of threads
+	 *	(a UI, network handlers, test drivers) for the one thread that propagates.
+	 *
+	 *	write() never locks: it is a push into an MpscChannel. The simulation
+	 *	thread applies the writes with drain() at its own safe points; the engines
+	 *	that accept an Ingress (EventDrivenEngine, ClockScheduler) do so at every
+	 *	wave boundary, so no write ever races with an evaluation. Writes to one
+	 *	component applied by the same drain() coalesce: its outputs only see the last.
+	 *
+	 *	Components are addressed by Handle, which stays valid while the Netlist
+	 *	compacts or erases other components; writes to erased components are dropped.
+	 *
+	 *	Every accepted write is a unit of outstanding work until the engine that
+	 *	applied it reports the Netlist settled, or discards the propagation it
+	 *	started (quiesced()), so writers can wait
+	 *	for the effect of their stimulus with settled() or onSettled(). Those wait
+	 *	for the writes accepted before the call only, in queue order, so a writer
+	 *	is not held back by others that keep writing. Waiters are resolved on the
+	 *	simulation thread, except when nothing they wait for is left.
+	 *
+	 *	\param	bit_width
+	 *		This template argument specifies the width of the internal bitset state.
+	 */
+	template <size_t bit_width>
+	class Ingress : public CacheAligned {
+		private:
+			struct Write {
+				Handle							target;
+				typename StateWord<bit_width>::type	value;
+			};
+
+			MpscChannel<Write>		channel;
+			size_t					batch;
+			std::atomic<uint64_t>	rejected;
+			uint64_t				dropped;
+
+			Settlement				work;		// Counts the writes settled, in queue order
+			size_t					applied;	// Drained writes whose propagation did not settle yet
+
+		public:
+			/**	\brief	Default constructor
+			 *
+			 *	\param	capacity
+			 *		Minimal amount of writes that can be pending, rounded up to a power of two.
+			 *	\param	batch
+			 *		Maximum amount of writes applied per drain(), 0 for all pending ones.
+			 */
+			Ingress(size_t capacity = 1024, size_t batch = 0)
+				: channel(capacity), batch(batch), rejected(0), dropped(0), applied(0)
+			{}
+
+			/**	\brief	Queues a new state for the component h refers to (any thread, lock-free).
+			 *
+			 *	\return	bool
+			 *		Returns false when the queue is full; the write is then lost.
+			 */
+			bool write(const Handle& h, const std::bitset<bit_width>& value) {
+				const Write w = { h, StateWord<bit_width>::from(value) };
+				if (this->channel.push(w)) return true;
+
+				this->rejected.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			/**	\brief	Gets a future that becomes ready once every write accepted so far is applied and settled.
+			 *
+			 *	The future is resolved on the simulation thread, inside quiesced(), or
+			 *	right away when those writes already settled. Later writes do not delay it.
+			 */
+			inline std::future<void> settled() {
+				return this->work.settled(this->channel.pushed());
+			}
+
+			/**	\brief	Calls f once every write accepted so far is applied and settled.
+			 *
+			 *	f runs on the simulation thread, inside quiesced(), or right away on the
+			 *	calling thread when those writes already settled.
+			 */
+			inline void onSettled(const std::function<void()>& f) {
+				this->work.onSettled(this->channel.pushed(), f);
+			}
+
+			/**	\brief	Gets the amount of writes that are queued, or applied but not settled yet.
+			 */
+			inline size_t pending() const {
+				const uint64_t done = this->work.finished();	// First, so it never exceeds the writes read after it
+				return size_t(this->channel.pushed() - done);
+			}
+
+			/**	\brief	Reports that the Netlist settled after all drained writes, or that
+			 *	their propagation was discarded (simulation thread only).
+			 */
+			inline void quiesced() {
+				const size_t n = this->applied;
+				this->applied = 0;
+				this->work.end(n);
+			}
+
+			/**	\brief	Gets the amount of writes lost because the queue was full.
+			 */
+			inline uint64_t overflows() const {
+				return this->rejected.load(std::memory_order_relaxed);
+			}
+
+			/**	\brief	Gets the amount of writes dropped because their component was erased.
+			 */
+			inline uint64_t stale() const {
+				return this->dropped;
+			}
+
+			/**	\brief	Applies pending writes to netlist (simulation thread only).
+			 *
+			 *	\param	netlist
+			 *		The Netlist the handles refer to.
+			 *	\param	changed
+			 *		Called with the index of every component whose state the write changed.
+			 *
+			 *	\return	size_t
+			 *		Returns the amount of writes taken from the queue.
+			 */
+			template <class Changed>
+			size_t drain(Netlist<bit_width>& netlist, Changed changed) {
+				Write w;
+				size_t taken = 0;
+
+				while ((this->batch == 0 || taken < this->batch) && this->channel.pop(w)) {
+					taken++;
+					this->applied++;
+
+					const size_t i = netlist.indexOf(w.target);
+					if (i == Netlist<bit_width>::npos) {
+						this->dropped++;
+						continue;
+					}
+
+					if (netlist.getWord(i) == w.value) continue;
+					netlist.setWord(i, w.value);
+					changed(i);
+				}
+
+				return taken;
+			}
+	};
+
+}
+
+#endif // SYNCHROTRONINGRESS_HPP
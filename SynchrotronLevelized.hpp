@@ -0,0 +1,267 @@
+/**
+*	Levelized oblivious evaluation of a Netlist, optionally spread over a ThreadPool.
+*/
+#ifndef SYNCHROTRONLEVELIZED_HPP
+#define SYNCHROTRONLEVELIZED_HPP
+
+#include "SynchrotronDirty.hpp"
+#include "SynchrotronNetlist.hpp"
+#include "SynchrotronThreadPool.hpp"
+#include "SynchrotronTrace.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace Synchrotron {
+
+	/** \brief
+	 *	LevelizedEngine evaluates every component of a Netlist once per step,
+	 *	in topological order, so the whole netlist settles in a single pass.
+	 *
+	 *	Components of the same level have no connections between them and
+	 *	are evaluated in parallel by step(ThreadPool&), with one barrier per level.
+	 *	Each level is sorted by index and split at cache line boundaries of the
+	 *	Netlist states, so no two workers ever write into the same line.
+	 *	Components on (or behind) a cycle get no level; they are iterated
+	 *	sequentially until they no longer change, after all levels.
+	 *
+	 *	With a CommitLog (setLog()) the changes of level l are recorded as step l,
+	 *	and those of settling pass k as step levels() + k.
+	 *
+	 *	\param	bit_width
+	 *		This template argument specifies the width of the internal bitset state.
+	 */
+	template <size_t bit_width>
+	class LevelizedEngine {
+		private:
+			Netlist<bit_width>	&netlist;
+
+			/**	\brief	Component indices, level by level.
+			 *
+			 *		Level l is order[levelOffset[l] .. levelOffset[l + 1]),
+			 *		the cyclic rest is order[levelOffset.back() .. size()).
+			 */
+			std::vector<size_t>	order, levelOffset;
+
+			/**	\brief	Worker w evaluates order[split[l * (workers + 1) + w] .. split[l * (workers + 1) + w + 1]) of level l.
+			 */
+			std::vector<size_t>	split;
+
+			/**	\brief	Per worker amount of changes during step(ThreadPool&).
+			 */
+			std::unique_ptr<Padded<size_t>[]>	changed;
+			size_t						workers;
+
+			CommitLog<bit_width>		*log;
+
+			/**	\brief	Cyclic components changed during the current step, and how often they changed again.
+			 */
+			DirtySet					cycled;
+			size_t						repeated;
+
+			/**	\brief	Components the last step changed, each counted once.
+			 */
+			size_t						components;
+
+			struct Run {
+				LevelizedEngine	*self;
+				ThreadPool		*pool;
+			};
+
+			/**	\brief	Evaluates order[first .. last) as part of step, on lane, marking the changed components in seen if given.
+			 *
+			 *	\return	size_t
+			 *		Returns the amount of components that changed.
+			 */
+			inline size_t evaluate(size_t first, size_t last, size_t lane, uint64_t step, DirtySet* seen = nullptr) {
+				size_t changed = 0;
+
+				for(size_t k = first; k < last; k++) {
+					const size_t i = this->order[k];
+					if (!this->netlist.evaluate(i)) continue;
+
+					changed++;
+					if (seen) seen->mark(i);
+					if (this->log) this->log->record(lane, step, i, this->netlist.getState(i));
+				}
+
+				return changed;
+			}
+
+			/**	\brief	Iterates the cyclic rest until it is stable.
+			 */
+			size_t settleCycles() {
+				size_t total = 0, changed;
+				uint64_t step = this->levels();
+
+				do {
+					changed = this->evaluate(this->levelOffset.back(), this->order.size(), 0, step++, &this->cycled);
+					total  += changed;
+				} while (changed);
+
+				this->repeated = total - this->cycled.count();
+				this->cycled.clear();
+
+				if (this->log) this->log->publish();
+				return total;
+			}
+
+			/**	\brief	Divides every level evenly over the workers, at cache line boundaries.
+			 */
+			void splitLevels() {
+				const size_t workers = this->workers;
+				this->split.assign(this->levels() * (workers + 1), 0);
+
+				for(size_t l = 0; l < this->levels(); l++) {
+					const size_t first = this->levelOffset[l], last = this->levelOffset[l + 1];
+					size_t *split = &this->split[l * (workers + 1)];
+
+					for(size_t w = 0; w <= workers; w++) {
+						size_t p = std::max(w ? split[w - 1] : first, first + (last - first) * w / workers);
+						while (p > first && p < last && this->netlist.shareLine(this->order[p - 1], this->order[p])) p++;
+						split[w] = p;
+					}
+				}
+			}
+
+			static void stepKernel(void* ctx, size_t worker) {
+				Run *run = static_cast<Run*>(ctx);
+				LevelizedEngine *self = run->self;
+				const size_t workers = run->pool->size();
+				size_t changed = 0;
+
+				for(size_t l = 0; l + 1 < self->levelOffset.size(); l++) {
+					const size_t *split = &self->split[l * (workers + 1)];
+
+					changed += self->evaluate(split[worker], split[worker + 1], worker, l);
+					run->pool->sync(worker);
+				}
+
+				self->changed[worker].value = changed;
+			}
+
+		public:
+			/**	\brief	Default constructor
+			 *
+			 *		Levelizes the Netlist; its topology must not change afterwards.
+			 *
+			 *	\param	netlist
+			 *		The Netlist to evaluate.
+			 */
+			LevelizedEngine(Netlist<bit_width>& netlist)
+				: netlist(netlist), workers(0), log(nullptr), cycled(netlist.size()), repeated(0), components(0)
+			{
+				const size_t n = netlist.size();
+				std::vector<size_t> indegree(n, 0);
+
+				// Self loops don't constrain the order
+				for(size_t i = 0; i < n; i++)
+					for(const Index *in = netlist.inputsBegin(i), *end = netlist.inputsEnd(i); in != end; ++in)
+						indegree[i] += (*in != i);
+
+				for(size_t i = 0; i < n; i++)
+					if (indegree[i] == 0) this->order.push_back(i);
+
+				this->levelOffset.push_back(0);
+
+				// Kahn's algorithm, one level at a time
+				while (this->levelOffset.back() != this->order.size()) {
+					const size_t first = this->levelOffset.back(), last = this->order.size();
+					this->levelOffset.push_back(last);
+
+					for(size_t k = first; k < last; k++) {
+						const size_t i = this->order[k];
+
+						for(const Index *o = netlist.outputsBegin(i), *end = netlist.outputsEnd(i); o != end; ++o)
+							if (*o != i && --indegree[*o] == 0) this->order.push_back(*o);
+					}
+
+					std::sort(this->order.begin() + last, this->order.end());
+				}
+
+				for(size_t i = 0; i < n; i++)
+					if (indegree[i] != 0) this->order.push_back(i);
+			}
+
+			/**	\brief	Enables the deterministic mode.
+			 *
+			 *	Every change is recorded in log and published in canonical
+			 *	(step, index) order at the end of each step.
+			 *
+			 *	\param	log
+			 *		The CommitLog to record in, or nullptr to disable (the default).
+			 */
+			inline void setLog(CommitLog<bit_width>* log) {
+				this->log = log;
+			}
+
+			/**	\brief	Gets the amount of levels (excluding the cyclic rest).
+			 */
+			inline size_t levels() const {
+				return this->levelOffset.size() - 1;
+			}
+
+			/**	\brief	Gets the amount of components on or behind a cycle.
+			 */
+			inline size_t cyclic() const {
+				return this->order.size() - this->levelOffset.back();
+			}
+
+			/**	\brief	Gets the amount of components the last step changed, each counted once.
+			 *
+			 *	Unlike the returned amount of evaluations, this never exceeds size(),
+			 *	however often the cyclic rest changed a component.
+			 */
+			inline size_t changedComponents() const {
+				return this->components;
+			}
+
+			/**	\brief	Evaluates the whole Netlist once on the calling thread.
+			 *
+			 *	\return	size_t
+			 *		Returns the amount of evaluations that changed a state.
+			 */
+			size_t step() {
+				if (this->log) this->log->lanes(1);
+
+				size_t changed = 0;
+				for(size_t l = 0; l < this->levels(); l++)
+					changed += this->evaluate(this->levelOffset[l], this->levelOffset[l + 1], 0, l);
+
+				changed += this->settleCycles();
+				this->components = changed - this->repeated;
+				return changed;
+			}
+
+			/**	\brief	Evaluates the whole Netlist once, spreading each level over the pool.
+			 *
+			 *	\param	pool
+			 *		The workers to use.
+			 *
+			 *	\return	size_t
+			 *		Returns the amount of evaluations that changed a state.
+			 */
+			size_t step(ThreadPool& pool) {
+				if (this->workers != pool.size()) {
+					this->workers = pool.size();
+					this->changed.reset(new Padded<size_t>[this->workers]);
+					this->splitLevels();
+				}
+				if (this->log) this->log->lanes(this->workers);
+
+				Run run = { this, &pool };
+				pool.run(&LevelizedEngine::stepKernel, &run);
+
+				size_t changed = this->settleCycles();
+				for(size_t w = 0; w < this->workers; w++)
+					changed += this->changed[w].value;
+
+				this->components = changed - this->repeated;
+				return changed;
+			}
+	};
+
+}
+
+#endif // SYNCHROTRONLEVELIZED_HPP
@@ -0,0 +1,546 @@
+/**
+*	Index based snapshot of a network of SynchrotronComponents.
+*		Used by the propagation engines, which work on indices instead of pointers.
+*/
+#ifndef SYNCHROTRONNETLIST_HPP
+#define SYNCHROTRONNETLIST_HPP
+
+#include "SynchrotronComponent.hpp"
+#include "SynchrotronBarrier.hpp"
+#include "SynchrotronHandle.hpp"
+#include "SynchrotronObserver.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <initializer_list>
+
+namespace Synchrotron {
+
+	/** \brief
+	 *	Netlist collects every SynchrotronComponent connected to a list of roots
+	 *	and stores their connections in compressed (CSR) index arrays.
+	 *
+	 *	Components are ordered by `Mutex::compare`, so index `i` is the same
+	 *	regardless of the compiler's pointer order (see Test_Results.md).
+	 *	Connections are stored as 32-bit indices. Indices may change when components
+	 *	are erased or relocated; a Handle keeps referring to the same component
+	 *	and becomes stale (instead of dangling) once it is erased.
+	 *	compact() moves everything into fresh storage, optionally in a traversal order.
+	 *
+	 *	The Netlist keeps its own copy of every state; load() and store()
+	 *	synchronise them with the components.
+	 *
+	 *	Per component data is split by use: evaluation only touches the dense
+	 *	`Hot` records (state and adjacency offsets) and the index arrays, while
+	 *	the component object (with its lock and creation index) and a debug
+	 *	name live in `Cold` records that propagation never reads.
+	 *
+	 *	\param	bit_width
+	 *		This template argument specifies the width of the internal bitset state.
+	 */
+	template <size_t bit_width>
+	class Netlist {
+		public:
+			typedef SynchrotronComponent<bit_width>	Component;
+			typedef std::bitset<bit_width>			State;
+			typedef typename Component::Word		Word;
+
+		private:
+			/**	\brief	What evaluation needs of a component.
+			 *
+			 *		Inputs of component i are inIndex[hot[i].in .. hot[i + 1].in),
+			 *		outputs are outIndex[hot[i].out .. hot[i + 1].out).
+			 *		The last record only closes the ranges of the last component.
+			 */
+			struct Hot {
+				Word	state;		// The working copy of the component's state
+				Index	in, out;
+			};
+
+			/**	\brief	What evaluation never needs of a component.
+			 */
+			struct Cold {
+				Component	*component;
+				std::string	name;
+			};
+
+			std::vector<Hot>	hot;
+			std::vector<Cold>	cold;
+
+			/**	\brief	**Signals == inputs**
+			 */
+			std::vector<Index> inIndex;
+
+			/**	\brief	**Slots == outputs**
+			 */
+			std::vector<Index> outIndex;
+
+			/**	\brief	All indices, sorted by creation index (`Mutex::idx`) of their component.
+			 */
+			std::vector<Index> byCreation;
+
+			struct ByCreation {
+				const std::vector<Cold>	&cold;
+
+				inline bool operator() (Index i, const Component* c) const {
+					return Mutex::compare()(this->cold[i].component, c);
+				}
+			};
+
+			/**	\brief	Handle of every index.
+			 */
+			SlotMap handles;
+
+			/**	\brief	Callbacks on changes, or nullptr.
+			 */
+			Observers<bit_width> *observers;
+
+			/**	\brief	Drops the connections of component i from index (with offsets hot[].*first),
+			 *	renumbering the indices above it. Leaves hot[i] without connections.
+			 */
+			static void eraseFrom(std::vector<Hot>& hot, Index Hot::*first, std::vector<Index>& index, size_t i) {
+				std::vector<Index> kept;
+				kept.reserve(index.size());
+
+				for(size_t k = 0; k + 1 < hot.size(); k++) {
+					const Index begin = hot[k].*first, end = hot[k + 1].*first;
+					hot[k].*first = Index(kept.size());
+					if (k == i) continue;
+
+					for(Index e = begin; e < end; e++)
+						if (index[e] != i) kept.push_back(index[e] - (index[e] > i));
+				}
+
+				hot.back().*first = Index(kept.size());
+				index.swap(kept);
+			}
+
+			/**	\brief	Walks all connections starting from roots and builds the index arrays.
+			 *
+			 *	\param	first, last
+			 *		The range of components to start from.
+			 */
+			template <class Iterator>
+			void build(Iterator first, Iterator last) {
+				std::set<Component*, Mutex::compare> found(first, last);
+				std::vector<Component*> work(found.begin(), found.end());
+
+				while (!work.empty()) {
+					Component *c = work.back();
+					work.pop_back();
+
+					for(auto& connection : c->getInputs())
+						if (found.insert(connection).second) work.push_back(connection);
+
+					for(auto& connection : c->getOutputs())
+						if (found.insert(connection).second) work.push_back(connection);
+				}
+
+				const size_t n = found.size();
+				if (n >= SlotMap::npos) throw std::length_error("Netlist: too many components for 32-bit indices");
+
+				this->cold.reserve(n);
+				for(Component *c : found) {
+					const Cold record = { c, std::string() };
+					this->cold.push_back(record);
+					this->byCreation.push_back(Index(this->byCreation.size()));
+				}
+
+				this->hot.reserve(n + 1);
+				for(size_t i = 0; i < n; i++) {
+					const Hot record = { Word(), Index(this->inIndex.size()), Index(this->outIndex.size()) };
+					this->hot.push_back(record);
+
+					for(auto& connection : this->cold[i].component->getInputs())
+						this->inIndex.push_back(Index(this->indexOf(connection)));
+					for(auto& connection : this->cold[i].component->getOutputs())
+						this->outIndex.push_back(Index(this->indexOf(connection)));
+
+					if (this->inIndex.size() >= SlotMap::npos || this->outIndex.size() >= SlotMap::npos)
+						throw std::length_error("Netlist: too many connections for 32-bit indices");
+
+					// Keep both adjacency lists in canonical order
+					std::sort(this->inIndex.begin()  + record.in,  this->inIndex.end());
+					std::sort(this->outIndex.begin() + record.out, this->outIndex.end());
+					this->handles.push();
+				}
+
+				const Hot end = { Word(), Index(this->inIndex.size()), Index(this->outIndex.size()) };
+				this->hot.push_back(end);
+				this->load();
+			}
+
+		public:
+			/**	\brief	Index returned by indexOf() for components outside this Netlist.
+			 */
+			static const size_t npos = size_t(-1);
+
+			/**	\brief	Connection constructor
+			 *
+			 *	\param	roots
+			 *		Components to start from; everything connected to them is included.
+			 */
+			Netlist(std::initializer_list<Component*> roots) : observers(nullptr) {
+				this->build(roots.begin(), roots.end());
+			}
+
+			/**	\brief	Connection constructor
+			 *
+			 *	\param	roots
+			 *		Components to start from; everything connected to them is included.
+			 */
+			Netlist(const std::vector<Component*>& roots) : observers(nullptr) {
+				this->build(roots.begin(), roots.end());
+			}
+
+			/**	\brief	Gets the amount of components in this Netlist.
+			 */
+			inline size_t size() const {
+				return this->cold.size();
+			}
+
+			/**	\brief	Gets the amount of connections in this Netlist.
+			 */
+			inline size_t edges() const {
+				return this->outIndex.size();
+			}
+
+			/**	\brief	Gets the component at index i.
+			 */
+			inline Component* component(size_t i) const {
+				return this->cold[i].component;
+			}
+
+			/**	\brief	Gets the debug name of component i (empty unless set).
+			 */
+			inline const std::string& name(size_t i) const {
+				return this->cold[i].name;
+			}
+
+			/**	\brief	Sets the debug name of component i.
+			 */
+			inline void setName(size_t i, const std::string& name) {
+				this->cold[i].name = name;
+			}
+
+			/**	\brief	Looks up the index of a component.
+			 *
+			 *	\param	c
+			 *		The component to find.
+			 *
+			 *	\return	size_t
+			 *		Returns the index of c, or `Netlist::npos` when c is not part of this Netlist.
+			 */
+			size_t indexOf(const Component* c) const {
+				const ByCreation less = { this->cold };
+				auto it = std::lower_bound(this->byCreation.begin(), this->byCreation.end(), c, less);
+				return (it != this->byCreation.end() && this->cold[*it].component == c) ? size_t(*it) : npos;
+			}
+
+			/**	\brief	Gets the handle of the component at index i.
+			 */
+			inline Handle handle(size_t i) const {
+				return this->handles.handle(i);
+			}
+
+			/**	\brief	Gets whether h still refers to a component of this Netlist.
+			 */
+			inline bool valid(const Handle& h) const {
+				return this->handles.valid(h);
+			}
+
+			/**	\brief	Looks up the current index of a component.
+			 *
+			 *	\param	h
+			 *		The handle of the component to find.
+			 *
+			 *	\return	size_t
+			 *		Returns the index, or `Netlist::npos` when the component was erased.
+			 */
+			inline size_t indexOf(const Handle& h) const {
+				const Index i = this->handles.find(h);
+				if (i == SlotMap::npos) return npos;
+				return i;
+			}
+
+			/**	\brief	Removes a component and all its connections from this Netlist.
+			 *
+			 *		Indices above it move down by one; handles stay valid, except h.
+			 *		Engines built on this Netlist must be rebuilt.
+			 *
+			 *	\return	bool
+			 *		Returns false when h was already stale.
+			 */
+			bool erase(const Handle& h) {
+				const size_t i = this->indexOf(h);
+				if (i == npos) return false;
+
+				this->byCreation.erase(std::find(this->byCreation.begin(), this->byCreation.end(), Index(i)));
+				for(auto& k : this->byCreation) k -= (k > i);
+
+				eraseFrom(this->hot, &Hot::in,  this->inIndex,  i);
+				eraseFrom(this->hot, &Hot::out, this->outIndex, i);
+				this->hot.erase(this->hot.begin() + i);
+				this->cold.erase(this->cold.begin() + i);
+				this->handles.erase(i);
+				if (this->observers) this->observers->erased(i);
+				return true;
+			}
+
+			/**	\brief	Gets whether the hot records of components a < b share a cache line,
+			 *	so that workers writing both would falsely share it.
+			 */
+			inline bool shareLine(size_t a, size_t b) const {
+				const uintptr_t lastOfA = uintptr_t(&this->hot[a]) + sizeof(Hot) - 1, firstOfB = uintptr_t(&this->hot[b]);
+				return lastOfA / SYNCHROTRON_CACHE_LINE >= firstOfB / SYNCHROTRON_CACHE_LINE;
+			}
+
+			/**	\brief	Splits the components into parts contiguous blocks of index,
+			 *	moving each boundary up until no cache line of states spans two blocks.
+			 *
+			 *	\return	std::vector<size_t>
+			 *		Returns the block of every component, usable as partitionOf of the timed engines.
+			 */
+			std::vector<size_t> blocks(size_t parts) const {
+				const size_t n = this->size();
+				std::vector<size_t> partitionOf(n);
+
+				for(size_t p = 0, first = 0; p < parts; p++) {
+					size_t last = std::max(first, n * (p + 1) / parts);
+					while (last > 0 && last < n && this->shareLine(last - 1, last)) last++;
+
+					for(size_t i = first; i < last; i++) partitionOf[i] = p;
+					first = last;
+				}
+
+				return partitionOf;
+			}
+
+			/**	\brief	Orders for compact().
+			 */
+			enum Order {
+				KeepOrder = 0,		///< Keep the current indices
+				BreadthFirst = 1	///< Number components in breadth-first order along their outputs
+			};
+
+			/**	\brief	Gets the amount of heap memory held by this Netlist, in bytes.
+			 */
+			size_t bytes() const {
+				return this->hot.capacity() * sizeof(Hot)
+					 + this->cold.capacity() * sizeof(Cold)
+					 + (this->inIndex.capacity() + this->outIndex.capacity() + this->byCreation.capacity()) * sizeof(Index)
+					 + this->handles.bytes();
+			}
+
+			/**	\brief	Moves all components and connections into fresh, exactly sized storage.
+			 *
+			 *		With `BreadthFirst`, components that drive each other get neighbouring
+			 *		indices, so propagation walks memory mostly forward. Sources (components
+			 *		without inputs) are visited first, in creation order. Indices then no
+			 *		longer follow `Mutex::idx`, but the new order does not depend on threads
+			 *		or pointers either. Handles stay valid; engines must be rebuilt.
+			 *
+			 *	\param	order
+			 *		The order to store the components in.
+			 *
+			 *	\return	size_t
+			 *		Returns the amount of bytes reclaimed.
+			 */
+			size_t compact(Order order = KeepOrder) {
+				const size_t before = this->bytes(), n = this->size();
+				std::vector<Index> from, to(n);		// New index -> old, old -> new
+				from.reserve(n);
+
+				if (order == BreadthFirst) {
+					std::vector<bool> seen(n, false);
+
+					for(int pass = 0; pass < 2; pass++) {
+						for(Index s : this->byCreation) {
+							if (seen[s] || (pass == 0 && this->inputsBegin(s) != this->inputsEnd(s))) continue;
+
+							seen[s] = true;
+							size_t k = from.size();
+							from.push_back(s);
+
+							for(; k < from.size(); k++) {
+								for(const Index *o = this->outputsBegin(from[k]), *end = this->outputsEnd(from[k]); o != end; ++o) {
+									if (seen[*o]) continue;
+									seen[*o] = true;
+									from.push_back(*o);
+								}
+							}
+						}
+					}
+				} else {
+					for(size_t i = 0; i < n; i++) from.push_back(Index(i));
+				}
+
+				for(size_t k = 0; k < n; k++) to[from[k]] = Index(k);
+
+				std::vector<Hot> hot;
+				std::vector<Cold> cold;
+				std::vector<Index> byCreation, inIndex, outIndex;
+				hot.reserve(n + 1);
+				cold.reserve(n);
+				byCreation.reserve(n);
+				inIndex.reserve(this->inIndex.size());
+				outIndex.reserve(this->outIndex.size());
+
+				for(size_t k = 0; k < n; k++) {
+					const size_t i = from[k];
+					const Hot record = { this->hot[i].state, Index(inIndex.size()), Index(outIndex.size()) };
+					hot.push_back(record);
+					cold.push_back(this->cold[i]);
+
+					for(const Index *in = this->inputsBegin(i), *end = this->inputsEnd(i); in != end; ++in)
+						inIndex.push_back(to[*in]);
+					for(const Index *o = this->outputsBegin(i), *end = this->outputsEnd(i); o != end; ++o)
+						outIndex.push_back(to[*o]);
+
+					std::sort(inIndex.begin()  + record.in,  inIndex.end());
+					std::sort(outIndex.begin() + record.out, outIndex.end());
+				}
+
+				const Hot end = { Word(), Index(inIndex.size()), Index(outIndex.size()) };
+				hot.push_back(end);
+
+				for(Index i : this->byCreation) byCreation.push_back(to[i]);
+
+				this->hot.swap(hot);
+				this->cold.swap(cold);
+				this->byCreation.swap(byCreation);
+				this->inIndex.swap(inIndex);
+				this->outIndex.swap(outIndex);
+
+				this->handles.permute(to);
+				this->handles.shrink();
+				if (this->observers) this->observers->permute(to);
+
+				const size_t after = this->bytes();
+				return before > after ? before - after : 0;
+			}
+
+			/**	\brief	Attaches callbacks on the changes evaluate() makes.
+			 *
+			 *	\param	observers
+			 *		The Observers to notify, or nullptr to detach (the default).
+			 */
+			inline void setObservers(Observers<bit_width>* observers) {
+				this->observers = observers;
+			}
+
+			/**	\brief	Gets the attached Observers, nullptr when none is.
+			 */
+			inline Observers<bit_width>* getObservers() const {
+				return this->observers;
+			}
+
+			/**	\brief	Gets the first input index of component i.
+			 */
+			inline const Index* inputsBegin(size_t i) const		{ return this->inIndex.data() + this->hot[i].in;		}
+			/**	\brief	Gets one past the last input index of component i.
+			 */
+			inline const Index* inputsEnd(size_t i) const		{ return this->inIndex.data() + this->hot[i + 1].in;	}
+			/**	\brief	Gets the first output index of component i.
+			 */
+			inline const Index* outputsBegin(size_t i) const	{ return this->outIndex.data() + this->hot[i].out;		}
+			/**	\brief	Gets one past the last output index of component i.
+			 */
+			inline const Index* outputsEnd(size_t i) const		{ return this->outIndex.data() + this->hot[i + 1].out;	}
+
+			/**	\brief	Gets the working state of component i.
+			 */
+			inline State getState(size_t i) const {
+				return StateWord<bit_width>::to(this->hot[i].state);
+			}
+
+			/**	\brief	Gets the working state of component i in its native storage.
+			 */
+			inline const Word& getWord(size_t i) const {
+				return this->hot[i].state;
+			}
+
+			/**	\brief	Sets the working state of component i, without propagating.
+			 */
+			inline void setState(size_t i, const State& value) {
+				this->hot[i].state = StateWord<bit_width>::from(value);
+			}
+
+			/**	\brief	Sets the working state of component i from its native storage, without propagating.
+			 */
+			inline void setWord(size_t i, const Word& value) {
+				this->hot[i].state = value;
+			}
+
+			/**	\brief	Computes the state component i would get from its inputs, without committing it.
+			 */
+			inline State nextState(size_t i) const {
+				return StateWord<bit_width>::to(this->nextWord(i));
+			}
+
+			/**	\brief	Computes the state component i would get from its inputs, in its native storage.
+			 */
+			inline Word nextWord(size_t i) const {
+				Word next = this->hot[i].state;
+
+				for(const Index *in = this->inputsBegin(i), *end = this->inputsEnd(i); in != end; ++in)
+					Component::fold(next, this->hot[*in].state);
+
+				StateWord<bit_width>::mask(next);
+				return next;
+			}
+
+			/**	\brief	Recomputes the working state of component i from its inputs.
+			 *
+			 *	Watched components notify their Observers when the state changed.
+			 *
+			 *	\return	bool
+			 *		Returns whether the state changed.
+			 */
+			inline bool evaluate(size_t i) {
+				return this->commit(i, this->nextWord(i));
+			}
+
+			/**	\brief	Commits a state computed by nextWord(i), e.g. after all registers of an edge sampled their inputs.
+			 *
+			 *	Watched components notify their Observers when the state changed.
+			 *
+			 *	\return	bool
+			 *		Returns whether the state changed.
+			 */
+			inline bool commit(size_t i, const Word& next) {
+				const bool changed = (next != this->hot[i].state);
+				this->hot[i].state = next;
+				if (changed && this->observers) this->observers->changed(i, next);
+				return changed;
+			}
+
+			/**	\brief	Copies the states of all components into this Netlist.
+			 *
+			 *	The components keep the states of the last store(), or of the construction
+			 *	of this Netlist when store() was never called; load() rolls back to those.
+			 */
+			void load() {
+				for(size_t i = 0; i < this->cold.size(); i++)
+					this->setState(i, this->cold[i].component->getState());
+			}
+
+			/**	\brief	Copies the working states back into the components.
+			 */
+			void store() const {
+				for(size_t i = 0; i < this->cold.size(); i++)
+					this->cold[i].component->setState(this->getState(i));
+			}
+	};
+
+	template <size_t bit_width>
+	const size_t Netlist<bit_width>::npos;
+
+}
+
+#endif // SYNCHROTRONNETLIST_HPP
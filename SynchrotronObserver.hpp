@@ -0,0 +1,270 @@
+/**
+*	Callbacks on the state changes of selected components of a Netlist.
+*/
+#ifndef SYNCHROTRONOBSERVER_HPP
+#define SYNCHROTRONOBSERVER_HPP
+
+#include "SynchrotronHandle.hpp"
+#include "SynchrotronWord.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Synchrotron {
+
+	template <class Signature, size_t capacity = 4 * sizeof(void*)>
+	class InlineFunction;
+
+	/** \brief
+	 *	InlineFunction holds any callable of up to `capacity` bytes inside itself,
+	 *	so unlike std::function it never allocates. Larger callables do not compile;
+	 *	capture a pointer to their state instead.
+	 *
+	 *	\param	capacity
+	 *		Size of the inline buffer in bytes, four pointers by default.
+	 */
+	template <size_t capacity, class R, class... Args>
+	class InlineFunction<R(Args...), capacity> {
+		private:
+			typedef typename std::aligned_storage<capacity, std::alignment_of<void*>::value>::type Storage;
+
+			Storage	storage;
+			R		(*call)(void*, Args...);
+			void	(*copy)(void*, const void*);
+			void	(*destroy)(void*);
+
+			template <class F> static R callAs(void* f, Args... args)			{ return (*static_cast<F*>(f))(std::forward<Args>(args)...);	}
+			template <class F> static void copyAs(void* to, const void* from)	{ new (to) F(*static_cast<const F*>(from));					}
+			template <class F> static void destroyAs(void* f)					{ static_cast<F*>(f)->~F();										}
+
+		public:
+			/**	\brief	Default constructor, holds nothing.
+			 */
+			InlineFunction() : call(nullptr), copy(nullptr), destroy(nullptr) {}
+
+			/**	\brief	Stores a copy of f in the inline buffer.
+			 */
+			template <class F, class = typename std::enable_if<!std::is_same<typename std::decay<F>::type, InlineFunction>::value>::type>
+			InlineFunction(F&& f) {
+				typedef typename std::decay<F>::type Callable;
+				static_assert(sizeof(Callable) <= capacity, "InlineFunction: callable does not fit the inline buffer");
+				static_assert(std::alignment_of<Callable>::value <= std::alignment_of<Storage>::value, "InlineFunction: callable is over-aligned");
+
+				new (&this->storage) Callable(std::forward<F>(f));
+				this->call		= &callAs<Callable>;
+				this->copy		= &copyAs<Callable>;
+				this->destroy	= &destroyAs<Callable>;
+			}
+
+			InlineFunction(const InlineFunction& other) : call(other.call), copy(other.copy), destroy(other.destroy) {
+				if (this->copy) this->copy(&this->storage, &other.storage);
+			}
+
+			InlineFunction& operator=(const InlineFunction& other) {
+				if (this == &other) return *this;
+
+				this->reset();
+				if (other.copy) other.copy(&this->storage, &other.storage);
+				this->call		= other.call;
+				this->copy		= other.copy;
+				this->destroy	= other.destroy;
+				return *this;
+			}
+
+			~InlineFunction() {
+				this->reset();
+			}
+
+			/**	\brief	Destroys the held callable.
+			 */
+			inline void reset() {
+				if (this->destroy) this->destroy(&this->storage);
+				this->call		= nullptr;
+				this->copy		= nullptr;
+				this->destroy	= nullptr;
+			}
+
+			/**	\brief	Gets whether a callable is held.
+			 */
+			inline explicit operator bool() const {
+				return this->call != nullptr;
+			}
+
+			/**	\brief	Calls the held callable, which must exist.
+			 */
+			inline R operator() (Args... args) const {
+				return this->call(const_cast<Storage*>(&this->storage), std::forward<Args>(args)...);
+			}
+	};
+
+	/** \brief
+	 *	Observers calls back on every evaluation that changes the state of a
+	 *	watched component, for monitors and scoreboards that would otherwise
+	 *	subclass components and pay a virtual tick() on all of them.
+	 *
+	 *	A Netlist with Observers attached (Netlist::setObservers()) only looks
+	 *	at them when an evaluation changed a state, and then tests a single bit
+	 *	before doing anything else, so components nobody watches cost nothing
+	 *	extra and Netlists without Observers one never taken branch per change.
+	 *	Callbacks are InlineFunction, so watching and notifying never allocate.
+	 *
+	 *	Only evaluations notify, and the updates the timed engines apply (see
+	 *	ConservativeEngine, OptimisticEngine): states set from outside (setState(),
+	 *	an Ingress) do not. Callbacks run on the thread that evaluated the component,
+	 *	which for the parallel engines is a worker, and must not watch() or unwatch().
+	 *
+	 *	Components are watched by index; the Netlist keeps the indices up to date
+	 *	when it erases or compacts components.
+	 *
+	 *	\param	bit_width
+	 *		This template argument specifies the width of the internal bitset state.
+	 */
+	template <size_t bit_width>
+	class Observers {
+		public:
+			typedef InlineFunction<void(size_t, const std::bitset<bit_width>&)>	Callback;
+			typedef size_t	Id;
+
+		private:
+			struct Entry {
+				Index		component;
+				Id			id;
+				Callback	callback;
+
+				inline bool operator< (const Entry& other) const {
+					return this->component < other.component;
+				}
+			};
+
+			/**	\brief	All callbacks, sorted by component, then registration order.
+			 */
+			std::vector<Entry>		entries;
+
+			/**	\brief	One bit per index, set for every watched component.
+			 */
+			std::vector<uint64_t>	watched;
+
+			Id						nextId;
+
+			/**	\brief	Recomputes the watched bits from the entries.
+			 */
+			void rebuild() {
+				std::fill(this->watched.begin(), this->watched.end(), 0);
+
+				for(const Entry& e : this->entries) {
+					if ((e.component >> 6) >= this->watched.size()) this->watched.resize((e.component >> 6) + 1, 0);
+					this->watched[e.component >> 6] |= uint64_t(1) << (e.component & 63);
+				}
+			}
+
+			/**	\brief	Calls every callback of component i.
+			 */
+			void notify(size_t i, const std::bitset<bit_width>& state) const {
+				Entry key;
+				key.component = Index(i);
+
+				for(auto it = std::lower_bound(this->entries.begin(), this->entries.end(), key); it != this->entries.end() && it->component == i; ++it)
+					it->callback(i, state);
+			}
+
+		public:
+			Observers() : nextId(0) {}
+
+			/**	\brief	Calls f with the index and new state of component i whenever an evaluation changes it.
+			 *
+			 *	\param	f
+			 *		Any callable taking `(size_t, const std::bitset<bit_width>&)` that fits an InlineFunction.
+			 *
+			 *	\return	Id
+			 *		Returns the id to unwatch() with.
+			 */
+			template <class F>
+			Id watch(size_t i, F&& f) {
+				Entry e;
+				e.component	= Index(i);
+				e.id		= this->nextId++;
+				e.callback	= Callback(std::forward<F>(f));
+
+				this->entries.insert(std::upper_bound(this->entries.begin(), this->entries.end(), e), e);
+				this->rebuild();
+				return e.id;
+			}
+
+			/**	\brief	Removes the callback registered as id.
+			 *
+			 *	\return	bool
+			 *		Returns false when id was not registered.
+			 */
+			bool unwatch(Id id) {
+				for(size_t k = 0; k < this->entries.size(); k++) {
+					if (this->entries[k].id != id) continue;
+
+					this->entries.erase(this->entries.begin() + k);
+					this->rebuild();
+					return true;
+				}
+
+				return false;
+			}
+
+			/**	\brief	Removes all callbacks.
+			 */
+			void clear() {
+				this->entries.clear();
+				this->rebuild();
+			}
+
+			/**	\brief	Gets the amount of registered callbacks.
+			 */
+			inline size_t size() const {
+				return this->entries.size();
+			}
+
+			/**	\brief	Gets whether any callback watches component i.
+			 */
+			inline bool observes(size_t i) const {
+				return (i >> 6) < this->watched.size() && ((this->watched[i >> 6] >> (i & 63)) & 1);
+			}
+
+			/**	\brief	Reports that an evaluation changed component i to state (evaluating thread).
+			 */
+			inline void changed(size_t i, const typename StateWord<bit_width>::type& state) const {
+				if (this->observes(i)) this->notify(i, StateWord<bit_width>::to(state));
+			}
+
+			/**	\brief	Follows the Netlist erasing component i: drops its callbacks and renumbers the ones above.
+			 */
+			void erased(size_t i) {
+				std::vector<Entry> kept;
+				kept.reserve(this->entries.size());
+
+				for(Entry& e : this->entries) {
+					if (e.component == i) continue;
+					e.component -= (e.component > i);
+					kept.push_back(e);
+				}
+
+				this->entries.swap(kept);
+				this->rebuild();
+			}
+
+			/**	\brief	Follows the Netlist moving every component from index k to to[k].
+			 */
+			void permute(const std::vector<Index>& to) {
+				for(Entry& e : this->entries) e.component = to[e.component];
+
+				std::stable_sort(this->entries.begin(), this->entries.end(), [](const Entry& a, const Entry& b) {
+					return a.component < b.component || (a.component == b.component && a.id < b.id);
+				});
+				this->rebuild();
+			}
+	};
+
+}
+
+#endif // SYNCHROTRONOBSERVER_HPP
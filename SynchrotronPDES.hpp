@@ -0,0 +1,486 @@
+/**
+*	Conservative parallel discrete-event simulation (Chandy-Misra-Bryant with null messages).
+*/
+#ifndef SYNCHROTRONPDES_HPP
+#define SYNCHROTRONPDES_HPP
+
+#include "SynchrotronNetlist.hpp"
+#include "SynchrotronChannel.hpp"
+#include "SynchrotronEvent.hpp"
+#include "SynchrotronThreadPool.hpp"
+#include "SynchrotronTrace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <vector>
+
+namespace Synchrotron {
+
+	/** \brief
+	 *	ConservativeEngine simulates a Netlist with gate delays, split in partitions
+	 *	that each run on their own worker.
+	 *
+	 *	When component i evaluates to a new state at time t, that state reaches its
+	 *	outputs at `t + delay(i)`. A partition therefore knows it won't send anything
+	 *	earlier than its own clock plus its lookahead (the smallest delay of a component
+	 *	with outputs in another partition) and promises so with null messages.
+	 *	Each partition only processes events older than every promise it received,
+	 *	so no partition ever has to undo work.
+	 *
+	 *	Cross-partition updates travel through SpscChannels, one per connected pair.
+	 *	The order of events is fully determined by (time, kind, index),
+	 *	so results do not depend on the partitioning or the amount of threads.
+	 *
+	 *	Every applied update that changes a component notifies the Observers of
+	 *	the Netlist, on the worker of its partition.
+	 *
+	 *	\param	bit_width
+	 *		This template argument specifies the width of the internal bitset state.
+	 */
+	template <size_t bit_width>
+	class ConservativeEngine {
+		public:
+			typedef std::bitset<bit_width>	State;
+			typedef Event<bit_width>		Ev;
+
+		private:
+			static const size_t npos = size_t(-1);
+
+			/**	\brief	Update sent to another partition, `index == npos` for null messages.
+			 */
+			struct Message {
+				SimTime	time;
+				size_t	index;
+				State	value;
+
+				inline bool operator> (const Message& other) const {
+					return this->time > other.time;
+				}
+			};
+
+			typedef SpscChannel<Message> Channel;
+
+			/**	\brief	One side of a channel, with the time of the last message through it.
+			 *
+			 *		Updates wait in the outbox until no earlier message can follow them,
+			 *		since a channel must carry non-decreasing times.
+			 *		Messages that don't fit in a full channel wait in the backlog of the
+			 *		sending side, so a partition never blocks on a partition sharing its worker.
+			 */
+			struct Link {
+				Channel				*channel;
+				SimTime				clock;
+				std::priority_queue<Message, std::vector<Message>, std::greater<Message> >	outbox;
+				std::vector<Message>	backlog;
+				size_t				flushed;
+			};
+
+			struct Partition {
+				std::priority_queue<Ev, std::vector<Ev>, std::greater<Ev> >	events;
+				std::vector<Link>	in, out;
+				std::vector<size_t>	outTo;			// Target partition per out link
+
+				/**	\brief	Components of other partitions that drive a component of this one.
+				 */
+				std::vector<size_t>	remote;
+				std::vector<State>	ghost;
+
+				SimTime	lookahead;
+				size_t	processed, nulls, messages;
+				bool	done;
+			};
+
+			Netlist<bit_width>		&netlist;
+			std::vector<size_t>		owner;
+			std::vector<SimTime>	delay;
+
+			/**	\brief	Latest scheduled state per component, the base of its next evaluation.
+			 */
+			std::vector<State>		projected;
+
+			/**	\brief	Time of the last scheduled evaluation per component, to merge duplicates.
+			 */
+			std::vector<SimTime>	lastEval;
+
+			/**	\brief	Out links of the owner partition to send updates of component i to:
+			 *		remoteLink[remoteOffset[i] .. remoteOffset[i + 1]).
+			 */
+			std::vector<size_t>		remoteOffset, remoteLink;
+
+			std::vector<Partition>	partitions;
+			std::vector<std::unique_ptr<Channel> >	channels;
+
+			SimTime					until;
+			std::atomic<size_t>		finished;
+			ThreadPool				*pool;
+
+			CommitLog<bit_width>	*log;	// One lane per partition
+
+			inline State& ghost(Partition& p, size_t i) {
+				return p.ghost[std::lower_bound(p.remote.begin(), p.remote.end(), i) - p.remote.begin()];
+			}
+
+			inline void scheduleEvaluate(Partition& p, SimTime t, size_t i) {
+				if (this->lastEval[i] == t) return;
+
+				this->lastEval[i] = t;
+				Ev e = { t, Ev::Evaluate, i, State() };
+				p.events.push(e);
+			}
+
+			/**	\brief	Moves all received messages into the event queue of partition p.
+			 */
+			void drain(Partition& p) {
+				Message m;
+
+				for(auto& link : p.in) {
+					while (link.channel->pop(m)) {
+						link.clock = m.time;
+						if (m.index == npos) continue;
+
+						Ev e = { m.time, Ev::Update, m.index, m.value };
+						p.events.push(e);
+					}
+				}
+			}
+
+			/**	\brief	Pushes as much of the backlog of every out link of p as fits.
+			 *
+			 *	\return	bool
+			 *		Returns whether all backlogs are empty.
+			 */
+			bool flush(Partition& p) {
+				bool empty = true;
+
+				for(auto& link : p.out) {
+					while (link.flushed < link.backlog.size() && link.channel->push(link.backlog[link.flushed]))
+						link.flushed++;
+
+					if (link.flushed == link.backlog.size()) {
+						link.backlog.clear();
+						link.flushed = 0;
+					} else {
+						empty = false;
+					}
+				}
+
+				return empty;
+			}
+
+			void send(Partition& p, size_t k, const Message& m) {
+				Link &link = p.out[k];
+
+				if (!link.backlog.empty() || !link.channel->push(m))
+					link.backlog.push_back(m);
+
+				link.clock = m.time;
+			}
+
+			void process(size_t id, const Ev& e) {
+				Partition &p = this->partitions[id];
+				const size_t i = e.index;
+				p.processed++;
+
+				if (e.kind == Ev::Update) {
+					if (this->owner[i] != id) {
+						this->ghost(p, i) = e.value;
+					} else {
+						// commit() notifies the Observers of the Netlist, on this worker
+						if (this->netlist.commit(i, StateWord<bit_width>::from(e.value)) && this->log)
+							this->log->record(id, e.time, i, e.value);
+					}
+
+					for(const Index *o = this->netlist.outputsBegin(i), *end = this->netlist.outputsEnd(i); o != end; ++o)
+						if (this->owner[*o] == id) this->scheduleEvaluate(p, e.time, *o);
+
+					return;
+				}
+
+				State next = this->projected[i];
+				for(const Index *in = this->netlist.inputsBegin(i), *end = this->netlist.inputsEnd(i); in != end; ++in)
+					SynchrotronComponent<bit_width>::fold(next, this->owner[*in] == id ? this->netlist.getState(*in) : this->ghost(p, *in));
+
+				if (next == this->projected[i]) return;
+
+				this->projected[i] = next;
+				const SimTime t = later(e.time, this->delay[i]);
+
+				Ev update = { t, Ev::Update, i, next };
+				p.events.push(update);
+
+				const Message m = { t, i, next };
+				for(size_t k = this->remoteOffset[i]; k < this->remoteOffset[i + 1]; k++) {
+					p.out[this->remoteLink[k]].outbox.push(m);
+					p.messages++;
+				}
+			}
+
+			/**	\brief	Runs one non-blocking iteration of partition id.
+			 *
+			 *	\return	bool
+			 *		Returns whether the partition reached `until`.
+			 */
+			bool advance(size_t id) {
+				Partition &p = this->partitions[id];
+				this->flush(p);
+				this->drain(p);
+
+				SimTime safe = never;
+				for(auto& link : p.in) safe = std::min(safe, link.clock);
+
+				const SimTime horizon = std::min(safe, this->until);
+				while (!p.events.empty() && p.events.top().time < horizon) {
+					const Ev e = p.events.top();
+					p.events.pop();
+					this->process(id, e);
+				}
+
+				// Lower bound on anything this partition will still do; never promise past `until`,
+				// since schedule() may add new events from there on before the next run()
+				const SimTime now = std::min(p.events.empty() ? never : p.events.top().time, safe);
+				const Message null = { later(std::min(now, this->until), p.lookahead), npos, State() };
+
+				for(size_t k = 0; k < p.out.size(); k++) {
+					Link &link = p.out[k];
+
+					// Anything this partition still sends will be at least null.time
+					while (!link.outbox.empty() && link.outbox.top().time <= null.time) {
+						this->send(p, k, link.outbox.top());
+						link.outbox.pop();
+					}
+
+					if (null.time > link.clock) {
+						this->send(p, k, null);
+						p.nulls++;
+					}
+				}
+
+				return this->flush(p) && now >= this->until;
+			}
+
+			static void runKernel(void* ctx, size_t worker) {
+				ConservativeEngine *self = static_cast<ConservativeEngine*>(ctx);
+				const size_t parts = self->partitions.size(), workers = self->pool->size();
+
+				if (worker >= parts) return;
+
+				while (self->finished.load(std::memory_order_acquire) != parts) {
+					for(size_t id = worker; id < parts; id += workers) {
+						Partition &p = self->partitions[id];
+
+						if (p.done) {
+							self->drain(p);
+							self->flush(p);
+						} else if (self->advance(id)) {
+							p.done = true;
+							self->finished.fetch_add(1, std::memory_order_acq_rel);
+						}
+					}
+				}
+			}
+
+			/**	\brief	Creates the channels between partitions and the lookahead of each.
+			 */
+			void connect(size_t channelCapacity) {
+				const size_t n = this->netlist.size(), parts = this->partitions.size();
+				std::vector<size_t> linkOf(parts * parts, npos);
+
+				this->remoteOffset.assign(1, 0);
+				for(size_t i = 0; i < n; i++) {
+					const size_t from = this->owner[i];
+
+					for(const Index *o = this->netlist.outputsBegin(i), *end = this->netlist.outputsEnd(i); o != end; ++o) {
+						const size_t to = this->owner[*o];
+						if (to == from) continue;
+
+						size_t &link = linkOf[from * parts + to];
+						if (link == npos) {
+							this->channels.push_back(std::unique_ptr<Channel>(new Channel(channelCapacity)));
+							Link l;
+							l.channel	= this->channels.back().get();
+							l.clock		= 0;
+							l.flushed	= 0;
+
+							link = this->partitions[from].out.size();
+							this->partitions[from].out.push_back(l);
+							this->partitions[from].outTo.push_back(to);
+							this->partitions[to].in.push_back(l);
+						}
+
+						if (std::find(this->remoteLink.begin() + this->remoteOffset.back(), this->remoteLink.end(), link) == this->remoteLink.end())
+							this->remoteLink.push_back(link);
+
+						this->partitions[to].remote.push_back(i);
+					}
+
+					this->remoteOffset.push_back(this->remoteLink.size());
+				}
+
+				for(auto& p : this->partitions) {
+					std::sort(p.remote.begin(), p.remote.end());
+					p.remote.erase(std::unique(p.remote.begin(), p.remote.end()), p.remote.end());
+
+					p.ghost.clear();
+					for(size_t i : p.remote) p.ghost.push_back(this->netlist.getState(i));
+				}
+			}
+
+		public:
+			/**	\brief	Default constructor
+			 *
+			 *	\param	netlist
+			 *		The Netlist to simulate; its topology must not change afterwards.
+			 *	\param	partitionOf
+			 *		The partition of every component, see blocks().
+			 *	\param	channelCapacity
+			 *		The amount of messages each channel can hold.
+			 */
+			ConservativeEngine(Netlist<bit_width>& netlist, const std::vector<size_t>& partitionOf, size_t channelCapacity = 1024)
+				: netlist(netlist), owner(partitionOf), delay(netlist.size(), 1),
+				  lastEval(netlist.size(), never), until(0), finished(0), pool(nullptr), log(nullptr)
+			{
+				const size_t parts = this->owner.empty() ? 0 : *std::max_element(this->owner.begin(), this->owner.end()) + 1;
+				this->partitions.resize(parts);
+
+				for(size_t i = 0; i < netlist.size(); i++)
+					this->projected.push_back(netlist.getState(i));
+
+				for(auto& p : this->partitions) {
+					p.processed = p.nulls = p.messages = 0;
+					p.done = false;
+				}
+
+				this->connect(channelCapacity);
+				this->updateLookahead();
+			}
+
+			/**	\brief	Splits n components into parts contiguous blocks of (creation) index.
+			 */
+			static std::vector<size_t> blocks(size_t n, size_t parts) {
+				std::vector<size_t> partitionOf(n);
+
+				for(size_t i = 0; i < n; i++)
+					partitionOf[i] = i * parts / (n ? n : 1);
+
+				return partitionOf;
+			}
+
+			/**	\brief	Sets the delay of component i (at least 1).
+			 */
+			void setDelay(size_t i, SimTime d) {
+				this->delay[i] = d ? d : 1;
+				this->updateLookahead();
+			}
+
+			/**	\brief	Recomputes the lookahead of every partition from the delays.
+			 */
+			void updateLookahead() {
+				for(auto& p : this->partitions) p.lookahead = never;
+
+				for(size_t i = 0; i < this->netlist.size(); i++) {
+					if (this->remoteOffset[i] == this->remoteOffset[i + 1]) continue;
+
+					SimTime &l = this->partitions[this->owner[i]].lookahead;
+					l = std::min(l, this->delay[i]);
+				}
+			}
+
+			/**	\brief	Gets the amount of partitions.
+			 */
+			inline size_t size() const {
+				return this->partitions.size();
+			}
+
+			/**	\brief	Gets the time up to which the simulation ran.
+			 */
+			inline SimTime now() const {
+				return this->until;
+			}
+
+			/**	\brief	Schedules an external change of component i.
+			 *
+			 *	\param	t
+			 *		The time of the change, not before now().
+			 *	\param	i
+			 *		The index of the component.
+			 *	\param	value
+			 *		Its new state.
+			 */
+			void schedule(SimTime t, size_t i, const State& value) {
+				const Ev e = { std::max(t, this->until), Ev::Update, i, value };
+				const size_t from = this->owner[i];
+
+				this->projected[i] = value;
+				this->partitions[from].events.push(e);
+
+				// Other partitions aren't running, so their ghosts can be told directly
+				for(size_t k = this->remoteOffset[i]; k < this->remoteOffset[i + 1]; k++)
+					this->partitions[this->partitions[from].outTo[this->remoteLink[k]]].events.push(e);
+			}
+
+			/**	\brief	Enables the deterministic mode.
+			 *
+			 *	Every change of a component state is recorded in log as step `time`,
+			 *	and published in canonical (time, index) order at the end of each run().
+			 *
+			 *	\param	log
+			 *		The CommitLog to record in, or nullptr to disable (the default).
+			 */
+			inline void setLog(CommitLog<bit_width>* log) {
+				this->log = log;
+			}
+
+			/**	\brief	Processes all events before time t.
+			 *
+			 *	Partition p runs on worker `p % pool.size()`; give the pool
+			 *	at least size() workers to run every partition on its own thread.
+			 *
+			 *	\return	size_t
+			 *		Returns the total amount of processed events so far.
+			 */
+			size_t run(SimTime t, ThreadPool& pool) {
+				this->until	= std::max(t, this->until);
+				this->pool	= &pool;
+				this->finished.store(0, std::memory_order_relaxed);
+				for(auto& p : this->partitions) p.done = false;
+				if (this->log) this->log->lanes(this->partitions.size());
+
+				pool.run(&ConservativeEngine::runKernel, this);
+				if (this->log) this->log->publish();
+				return this->processed();
+			}
+
+			/**	\brief	Gets the amount of events processed by all partitions.
+			 */
+			size_t processed() const {
+				size_t total = 0;
+				for(auto& p : this->partitions) total += p.processed;
+				return total;
+			}
+
+			/**	\brief	Gets the amount of null messages sent by all partitions.
+			 */
+			size_t nullMessages() const {
+				size_t total = 0;
+				for(auto& p : this->partitions) total += p.nulls;
+				return total;
+			}
+
+			/**	\brief	Gets the amount of updates sent across partitions.
+			 */
+			size_t messages() const {
+				size_t total = 0;
+				for(auto& p : this->partitions) total += p.messages;
+				return total;
+			}
+	};
+
+	template <size_t bit_width>
+	const size_t ConservativeEngine<bit_width>::npos;
+
+}
+
+#endif // SYNCHROTRONPDES_HPP
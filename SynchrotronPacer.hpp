@@ -0,0 +1,191 @@
+/**
+*	Runs a ClockScheduler in step with the wall clock.
+*/
+#ifndef SYNCHROTRONPACER_HPP
+#define SYNCHROTRONPACER_HPP
+
+#include "SynchrotronClock.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__unix__)
+#include <cerrno>
+#include <time.h>
+#include <unistd.h>
+#if defined(_POSIX_TIMERS) && _POSIX_TIMERS > 0 && defined(_POSIX_MONOTONIC_CLOCK)
+#define SYNCHROTRON_CLOCK_NANOSLEEP
+#endif
+#endif
+
+namespace Synchrotron {
+
+	/** \brief
+	 *	Timing statistics of paced runs, all durations in nanoseconds.
+	 *
+	 *	Lateness is how long after its deadline a batch actually resumed;
+	 *	an overrun is a batch whose simulation alone took longer than its slot.
+	 */
+	struct PaceStats {
+		uint64_t	batches;
+		uint64_t	overruns;
+		int64_t		maxLateness;	// Worst wake-up jitter
+		double		meanLateness;	// Average wake-up jitter
+		int64_t		maxOverrun;		// Worst amount a batch ran past its deadline
+		double		load;			// Fraction of wall time the last run spent simulating
+	};
+
+	/** \brief
+	 *	Pacer advances a ClockScheduler at a fixed rate of simulated time per wall clock time,
+	 *	for instance 1 MHz simulated in real time.
+	 *
+	 *	Simulated time is run in batches; after each batch the Pacer waits until the
+	 *	wall clock caught up with it. Waiting sleeps (clock_nanosleep on an absolute
+	 *	CLOCK_MONOTONIC deadline where POSIX timers exist, sleep_until elsewhere)
+	 *	until `spin` before the deadline, then busy-waits the rest, which keeps the
+	 *	jitter down to the scheduler wake-up latency that spinning hides.
+	 *
+	 *	A batch that overruns its deadline moves the schedule back by the overrun
+	 *	rather than rushing later batches to catch up.
+	 *
+	 *	A triggered watchpoint (ClockScheduler::setWatchpoints()) ends the run
+	 *	at the step it triggered; the next run continues from there.
+	 *
+	 *	\param	bit_width
+	 *		This template argument specifies the width of the internal bitset state.
+	 */
+	template <size_t bit_width>
+	class Pacer {
+		public:
+			typedef std::chrono::steady_clock Clock;
+
+		private:
+			ClockScheduler<bit_width>	&scheduler;
+			std::chrono::nanoseconds	unit, spin;
+			SimTime						batch;
+			SimTime						position;	// Simulated time run so far
+			PaceStats					statistics;
+
+			/**	\brief	Sleeps until shortly before deadline, then spins until it.
+			 */
+			void waitUntil(Clock::time_point deadline) const {
+				const Clock::duration coarse = (deadline - Clock::now()) - this->spin;
+
+				if (coarse > Clock::duration::zero()) {
+#if defined(SYNCHROTRON_CLOCK_NANOSLEEP)
+					timespec ts;
+					clock_gettime(CLOCK_MONOTONIC, &ts);
+
+					const int64_t ns = int64_t(ts.tv_nsec) + std::chrono::duration_cast<std::chrono::nanoseconds>(coarse).count();
+					ts.tv_sec	+= time_t(ns / 1000000000);
+					ts.tv_nsec	 = long(ns % 1000000000);
+
+					while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+#else
+					std::this_thread::sleep_until(deadline - this->spin);
+#endif
+				}
+
+				while (Clock::now() < deadline) {}
+			}
+
+			/**	\brief	Gets the wall clock time that simulated time should take.
+			 */
+			inline std::chrono::nanoseconds wall(SimTime time) const {
+				return std::chrono::nanoseconds(this->unit.count() * int64_t(time));
+			}
+
+		public:
+			/**	\brief	Default constructor
+			 *
+			 *	\param	scheduler
+			 *		The clocked Netlist to run.
+			 *	\param	unit
+			 *		Wall clock time per unit of simulated time, e.g. 1000 ns for 1 MHz with a period of 1.
+			 *	\param	batch
+			 *		Simulated time run between two waits; larger batches cost less, smaller ones react faster.
+			 *	\param	spin
+			 *		How long before each deadline sleeping turns into busy-waiting.
+			 */
+			Pacer(ClockScheduler<bit_width>& scheduler, std::chrono::nanoseconds unit, SimTime batch = 1000,
+				  std::chrono::nanoseconds spin = std::chrono::microseconds(100))
+				: scheduler(scheduler), unit(unit), spin(spin), batch(std::max<SimTime>(batch, 1)), position(scheduler.now())
+			{
+				this->reset();
+			}
+
+			/**	\brief	Gets the statistics of all runs since construction or reset().
+			 */
+			inline const PaceStats& stats() const {
+				return this->statistics;
+			}
+
+			/**	\brief	Clears the statistics.
+			 */
+			void reset() {
+				const PaceStats none = { 0, 0, 0, 0, 0, 0 };
+				this->statistics = none;
+			}
+
+			/**	\brief	Runs the scheduler in real time for duration units of simulated time.
+			 *
+			 *	Consecutive runs continue where the previous one stopped.
+			 *
+			 *	\return	const PaceStats&
+			 *		Returns the accumulated statistics.
+			 */
+			const PaceStats& run(SimTime duration) {
+				PaceStats &s = this->statistics;
+				const SimTime first = this->position;
+				const SimTime until = later(first, duration);
+
+				Clock::time_point start = Clock::now();
+				Clock::duration busy = Clock::duration::zero();
+				double lateness = s.meanLateness * double(s.batches - s.overruns);
+
+				for(SimTime t = first; t < until;) {
+					const Clock::time_point begin = Clock::now();
+
+					t = (until - t > this->batch) ? t + this->batch : until;
+					this->scheduler.run(t);
+					s.batches++;
+
+					// A watchpoint stopped the scheduler before the end of the batch
+					if (this->scheduler.nextEdge() <= t) {
+						this->position = this->scheduler.now();
+						break;
+					}
+
+					this->position = t;
+
+					const Clock::time_point done = Clock::now(), deadline = start + this->wall(t - first);
+					busy += done - begin;
+
+					if (done > deadline) {
+						const int64_t over = std::chrono::duration_cast<std::chrono::nanoseconds>(done - deadline).count();
+						s.overruns++;
+						s.maxOverrun = std::max(s.maxOverrun, over);
+						start += done - deadline;
+						continue;
+					}
+
+					this->waitUntil(deadline);
+
+					const int64_t late = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - deadline).count();
+					s.maxLateness = std::max(s.maxLateness, late);
+					lateness += double(late);
+				}
+
+				if (s.batches > s.overruns) s.meanLateness = lateness / double(s.batches - s.overruns);
+
+				const double seconds = std::chrono::duration<double>(this->wall(until - first)).count();
+				if (seconds > 0) s.load = std::chrono::duration<double>(busy).count() / seconds;
+				return s;
+			}
+	};
+
+}
+
+#endif // SYNCHROTRONPACER_HPP
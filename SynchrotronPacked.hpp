@@ -0,0 +1,425 @@
+/**
+*	Bit-packed netlist of 1-bit gates, evaluated 64 gates at a time.
+*/
+#ifndef SYNCHROTRONPACKED_HPP
+#define SYNCHROTRONPACKED_HPP
+
+#include "SynchrotronNetlist.hpp"
+#include "SynchrotronHandle.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <vector>
+
+namespace Synchrotron {
+
+	/** \brief
+	 *	PackedNetlist evaluates 1-bit gates 64 at a time.
+	 *
+	 *	States are packed 64 per `uint64_t` and inputs are kept in CSR arrays of
+	 *	32-bit slots. When packed, gates are levelized like in LevelizedEngine and
+	 *	stored grouped by (level, gate type), so step() evaluates up to 64 gates of
+	 *	one type together: the k-th inputs of all of them are gathered gate by gate
+	 *	into one column word, then the logic is applied to the whole column at once,
+	 *	with no switch on the gate type per gate. Groups share words; each writes
+	 *	its own bits through a mask.
+	 *
+	 *	Only the logic is word-parallel. The gather reads every input bit on its
+	 *	own through the CSR arrays, so a step costs one load per connection, like
+	 *	the bitset Netlist. Packing the fan-in as masks per source word would make
+	 *	it word-wide for regular wiring, but is not done. Memory is not a few bits
+	 *	per gate either: a gate takes one state bit, its type byte, a 32-bit input
+	 *	offset, a 32-bit slot and a 32-bit index per input, about 17 bytes for a
+	 *	gate with two inputs. bytes() reports the real amount.
+	 *
+	 *	Gates are numbered in the order they are added; add() and connect() may be
+	 *	called at any time, the netlist is repacked lazily on the next step().
+	 *	Gates on (or behind) a cycle are iterated one by one until stable, for at
+	 *	most one pass per cyclic gate plus one; rings with an odd amount of
+	 *	inversions never settle, which settled() reports after the step.
+	 */
+	class PackedNetlist {
+		public:
+			/**	\brief	The logic of a gate.
+			 */
+			enum Gate {
+				Hold = 0,	///< state | inputs, the SynchrotronComponent fold
+				Or,
+				And,
+				Xor,
+				Nor,
+				Nand,
+				Xnor
+			};
+
+		private:
+			/**	\brief	Level of gates on (or behind) a cycle.
+			 */
+			static const Index npos = Index(-1);
+
+			/**	\brief	Slots [first, last) hold gates of one type and level.
+			 */
+			struct Group {
+				Index	gate, first, last;
+			};
+
+			// Unpacked: gate types and states by gate, connections as pairs
+			std::vector<uint8_t>	gates;
+			std::vector<uint64_t>	loose;
+			std::vector<Index>		from, to;
+
+			// Packed: states and inputs by slot
+			bool					packed;
+			std::vector<uint64_t>	words;
+			std::vector<Index>		inOffset, inIndex;
+			std::vector<Index>		slotOf;
+			std::vector<Group>		groups;
+			size_t					cyclicGroup, levelCount;
+			bool					stable;		// Whether the cycles settled in the last step()
+
+			static inline bool bit(const std::vector<uint64_t>& words, size_t i) {
+				return (words[i >> 6] >> (i & 63)) & 1;
+			}
+
+			static inline void assign(std::vector<uint64_t>& words, size_t i, bool value) {
+				const uint64_t m = uint64_t(1) << (i & 63);
+				words[i >> 6] = value ? (words[i >> 6] | m) : (words[i >> 6] & ~m);
+			}
+
+			static inline size_t popcount(uint64_t x) {
+				return std::bitset<64>(x).count();
+			}
+
+			static inline bool inverted(size_t gate) {
+				return gate == Nor || gate == Nand || gate == Xnor;
+			}
+
+			/**	\brief	Evaluates slots [first, last) of group g, which lie in one word.
+			 *
+			 *	\return	size_t
+			 *		Returns the amount of gates that changed.
+			 */
+			size_t evaluateWord(const Group& g, Index first, Index last) {
+				const size_t count = last - first, shift = first & 63, w = first >> 6;
+				const uint64_t mask = ((count == 64) ? ~uint64_t(0) : ((uint64_t(1) << count) - 1)) << shift;
+				const Index *offset = &this->inOffset[first];
+
+				size_t fanin = 0;
+				for(size_t j = 0; j < count; j++)
+					fanin = std::max<size_t>(fanin, offset[j + 1] - offset[j]);
+
+				uint64_t acc = (g.gate == Hold) ? this->words[w] : ((g.gate == And || g.gate == Nand) ? ~uint64_t(0) : 0);
+
+				// Column k holds the k-th input of every gate in the word
+				for(size_t k = 0; k < fanin; k++) {
+					uint64_t column = 0, present = 0;
+
+					for(size_t j = 0; j < count; j++) {
+						if (offset[j] + k >= offset[j + 1]) continue;
+
+						present |= uint64_t(1) << (shift + j);
+						column  |= uint64_t(bit(this->words, this->inIndex[offset[j] + k])) << (shift + j);
+					}
+
+					switch (g.gate) {
+						case And: case Nand:	acc &= column | ~present;	break;
+						case Xor: case Xnor:	acc ^= column;				break;
+						default:				acc |= column;				break;
+					}
+				}
+
+				if (inverted(g.gate)) acc = ~acc;
+
+				const uint64_t next = (this->words[w] & ~mask) | (acc & mask);
+				const size_t changed = popcount(next ^ this->words[w]);
+				this->words[w] = next;
+				return changed;
+			}
+
+			/**	\brief	Evaluates the gate in slot s on its own.
+			 *
+			 *	\return	bool
+			 *		Returns whether it changed.
+			 */
+			bool evaluateSlot(size_t gate, Index s) {
+				const bool old = bit(this->words, s);
+				bool acc = (gate == Hold) ? old : (gate == And || gate == Nand);
+
+				for(Index e = this->inOffset[s]; e < this->inOffset[s + 1]; e++) {
+					const bool in = bit(this->words, this->inIndex[e]);
+
+					switch (gate) {
+						case And: case Nand:	acc = acc && in;	break;
+						case Xor: case Xnor:	acc = acc != in;	break;
+						default:				acc = acc || in;	break;
+					}
+				}
+
+				if (inverted(gate)) acc = !acc;
+
+				assign(this->words, s, acc);
+				return acc != old;
+			}
+
+			/**	\brief	Turns the packed arrays back into gates and connections.
+			 */
+			void unpack() {
+				if (!this->packed) return;
+
+				const size_t n = this->gates.size();
+				std::vector<Index> gateOf(n);
+				for(size_t i = 0; i < n; i++) gateOf[this->slotOf[i]] = Index(i);
+
+				this->loose.assign((n + 63) / 64, 0);
+				for(size_t i = 0; i < n; i++) {
+					const Index s = this->slotOf[i];
+					assign(this->loose, i, bit(this->words, s));
+
+					for(Index e = this->inOffset[s]; e < this->inOffset[s + 1]; e++) {
+						this->from.push_back(gateOf[this->inIndex[e]]);
+						this->to.push_back(Index(i));
+					}
+				}
+
+				std::vector<uint64_t>().swap(this->words);
+				std::vector<Index>().swap(this->inOffset);
+				std::vector<Index>().swap(this->inIndex);
+				std::vector<Index>().swap(this->slotOf);
+				this->groups.clear();
+				this->packed = false;
+			}
+
+			/**	\brief	Levelizes, groups and packs all gates.
+			 */
+			void pack() {
+				if (this->packed) return;
+
+				const size_t n = this->gates.size();
+
+				// Adjacency by gate, without duplicate connections (like the component sets)
+				std::vector<Index> inOff(n + 1, 0), outOff(n + 1, 0), ins(this->from.size()), outs(this->from.size());
+				for(size_t e = 0; e < this->from.size(); e++) {
+					inOff[this->to[e] + 1]++;
+					outOff[this->from[e] + 1]++;
+				}
+				for(size_t i = 0; i < n; i++) {
+					inOff[i + 1]  += inOff[i];
+					outOff[i + 1] += outOff[i];
+				}
+				{
+					std::vector<Index> inFill(inOff.begin(), inOff.end() - 1), outFill(outOff.begin(), outOff.end() - 1);
+					for(size_t e = 0; e < this->from.size(); e++) {
+						ins[inFill[this->to[e]]++]		= this->from[e];
+						outs[outFill[this->from[e]]++]	= this->to[e];
+					}
+				}
+
+				std::vector<Index> degree(n, 0);
+				for(size_t i = 0; i < n; i++) {
+					std::sort(ins.begin() + inOff[i], ins.begin() + inOff[i + 1]);
+					std::sort(outs.begin() + outOff[i], outs.begin() + outOff[i + 1]);
+
+					for(Index e = inOff[i]; e < inOff[i + 1]; e++)
+						degree[i] += (ins[e] != i) && (e == inOff[i] || ins[e] != ins[e - 1]);
+				}
+
+				// Kahn's algorithm, one level at a time; self loops don't constrain the order
+				std::vector<Index> level(n, Index(npos)), current, next;
+				for(size_t i = 0; i < n; i++)
+					if (degree[i] == 0) current.push_back(Index(i));
+
+				this->levelCount = 0;
+				while (!current.empty()) {
+					next.clear();
+
+					for(Index i : current) {
+						level[i] = Index(this->levelCount);
+
+						for(Index e = outOff[i]; e < outOff[i + 1]; e++) {
+							const Index o = outs[e];
+							if (o != i && (e == outOff[i] || o != outs[e - 1]) && --degree[o] == 0) next.push_back(o);
+						}
+					}
+
+					current.swap(next);
+					this->levelCount++;
+				}
+
+				// Group by (level, gate type, gate), cyclic gates last
+				std::vector<Index> order(n);
+				for(size_t i = 0; i < n; i++) order[i] = Index(i);
+				std::sort(order.begin(), order.end(), [&](Index a, Index b) {
+					if (level[a] != level[b]) return level[a] < level[b];
+					if (this->gates[a] != this->gates[b]) return this->gates[a] < this->gates[b];
+					return a < b;
+				});
+
+				this->slotOf.resize(n);
+				this->groups.clear();
+				this->cyclicGroup = 0;
+
+				for(size_t k = 0; k < n; k++) {
+					const Index i = order[k];
+					this->slotOf[i] = Index(k);
+
+					if (k == 0 || level[i] != level[order[k - 1]] || this->gates[i] != this->gates[order[k - 1]]) {
+						const Group g = { Index(this->gates[i]), Index(k), Index(k) };
+						this->groups.push_back(g);
+					}
+
+					this->groups.back().last = Index(k + 1);
+					if (level[i] != npos) this->cyclicGroup = this->groups.size();
+				}
+
+				// Inputs and states by slot
+				this->inOffset.assign(1, 0);
+				this->inOffset.reserve(n + 1);
+				this->inIndex.clear();
+				this->inIndex.reserve(ins.size());
+				this->words.assign((n + 63) / 64, 0);
+
+				for(size_t k = 0; k < n; k++) {
+					const Index i = order[k];
+
+					for(Index e = inOff[i]; e < inOff[i + 1]; e++)
+						if (e == inOff[i] || ins[e] != ins[e - 1]) this->inIndex.push_back(this->slotOf[ins[e]]);
+
+					this->inOffset.push_back(Index(this->inIndex.size()));
+					assign(this->words, k, bit(this->loose, i));
+				}
+
+				std::vector<Index>().swap(this->from);
+				std::vector<Index>().swap(this->to);
+				std::vector<uint64_t>().swap(this->loose);
+				this->packed = true;
+			}
+
+		public:
+			/**	\brief	Default constructor
+			 */
+			PackedNetlist() : packed(false), cyclicGroup(0), levelCount(0), stable(true) {}
+
+			/**	\brief	Conversion constructor
+			 *
+			 *		Every component becomes a `Hold` gate with the same state and inputs,
+			 *		so step() gives the same result as LevelizedEngine::step() on netlist.
+			 */
+			explicit PackedNetlist(const Netlist<1>& netlist) : packed(false), cyclicGroup(0), levelCount(0), stable(true) {
+				for(size_t i = 0; i < netlist.size(); i++)
+					this->add(Hold, netlist.getState(i)[0]);
+
+				for(size_t i = 0; i < netlist.size(); i++)
+					for(const Index *in = netlist.inputsBegin(i), *end = netlist.inputsEnd(i); in != end; ++in)
+						this->connect(*in, i);
+			}
+
+			/**	\brief	Adds a gate.
+			 *
+			 *	\return	size_t
+			 *		Returns the index of the new gate.
+			 */
+			size_t add(Gate gate, bool state = false) {
+				this->unpack();
+
+				const size_t i = this->gates.size();
+				this->gates.push_back(uint8_t(gate));
+				if ((i & 63) == 0) this->loose.push_back(0);
+				assign(this->loose, i, state);
+				return i;
+			}
+
+			/**	\brief	Makes gate `source` an input of gate `target`.
+			 */
+			void connect(size_t source, size_t target) {
+				this->unpack();
+				this->from.push_back(Index(source));
+				this->to.push_back(Index(target));
+			}
+
+			/**	\brief	Gets the amount of gates.
+			 */
+			inline size_t size() const {
+				return this->gates.size();
+			}
+
+			/**	\brief	Gets the state of gate i.
+			 */
+			inline bool getState(size_t i) const {
+				return this->packed ? bit(this->words, this->slotOf[i]) : bit(this->loose, i);
+			}
+
+			/**	\brief	Sets the state of gate i, without evaluating.
+			 */
+			inline void setState(size_t i, bool value) {
+				if (this->packed)	assign(this->words, this->slotOf[i], value);
+				else				assign(this->loose, i, value);
+			}
+
+			/**	\brief	Gets the amount of levels (excluding the cyclic rest), packing if needed.
+			 */
+			size_t levels() {
+				this->pack();
+				return this->levelCount;
+			}
+
+			/**	\brief	Evaluates every gate once, level by level, then settles cycles.
+			 *
+			 *	Cyclic gates are iterated at most once per cyclic gate plus once;
+			 *	when they still change after that, settled() returns false.
+			 *
+			 *	\return	size_t
+			 *		Returns the amount of evaluations that changed a state.
+			 */
+			size_t step() {
+				this->pack();
+				size_t total = 0, changed = 0;
+
+				for(size_t k = 0; k < this->cyclicGroup; k++) {
+					const Group &g = this->groups[k];
+
+					for(Index first = g.first, last; first < g.last; first = last) {
+						last = std::min<Index>(g.last, (first | 63) + 1);
+						total += this->evaluateWord(g, first, last);
+					}
+				}
+
+				const size_t cyclic = this->gates.size() - (this->cyclicGroup < this->groups.size() ? this->groups[this->cyclicGroup].first : this->gates.size());
+
+				for(size_t pass = 0; pass <= cyclic; pass++) {
+					changed = 0;
+					for(size_t k = this->cyclicGroup; k < this->groups.size(); k++)
+						for(Index s = this->groups[k].first; s < this->groups[k].last; s++)
+							changed += this->evaluateSlot(this->groups[k].gate, s);
+
+					total += changed;
+					if (!changed) break;
+				}
+
+				this->stable = (changed == 0);
+				return total;
+			}
+
+			/**	\brief	Gets whether the cyclic gates settled during the last step().
+			 *
+			 *	\return	bool
+			 *		Returns false when they still changed after the last allowed pass, e.g. a ring oscillator.
+			 */
+			inline bool settled() const {
+				return this->stable;
+			}
+
+			/**	\brief	Gets the amount of heap memory held, in bytes.
+			 */
+			size_t bytes() const {
+				return this->gates.capacity() * sizeof(uint8_t)
+					 + (this->loose.capacity() + this->words.capacity()) * sizeof(uint64_t)
+					 + (this->from.capacity() + this->to.capacity() + this->inOffset.capacity() + this->inIndex.capacity()
+						+ this->slotOf.capacity()) * sizeof(Index)
+					 + this->groups.capacity() * sizeof(Group);
+			}
+	};
+
+}
+
+#endif // SYNCHROTRONPACKED_HPP
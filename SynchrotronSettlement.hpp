@@ -0,0 +1,144 @@
+/**
+*	Notification when the outstanding work of a simulation is done.
+*/
+#ifndef SYNCHROTRONSETTLEMENT_HPP
+#define SYNCHROTRONSETTLEMENT_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace Synchrotron {
+
+	/** \brief
+	 *	Settlement counts finished units of work and notifies each waiter once
+	 *	the work it waits for is finished.
+	 *
+	 *	Units must finish in the order they were numbered, e.g. the order they
+	 *	leave a queue. A waiter holds a ticket, the amount of units that must have
+	 *	finished, usually the amount started when it registered; work started
+	 *	after that does not hold it back, however much keeps coming.
+	 *
+	 *	end() is a single atomic add while nobody waits; the lock is only taken
+	 *	when a waiter registers or end() finds waiters. Waiters are either futures
+	 *	(settled()) or callbacks (onSettled()), both resolved on the thread that
+	 *	calls end(), or right away when their ticket is already reached.
+	 *	Callbacks run before the futures become ready.
+	 */
+	class Settlement {
+		private:
+			std::atomic<uint64_t>	completed;
+			std::atomic<size_t>		waiting;	// Amount of registered waiters
+			std::mutex				m_mutex;
+
+			std::vector<std::pair<uint64_t, std::promise<void> > >		promises;
+			std::vector<std::pair<uint64_t, std::function<void()> > >	callbacks;
+
+			/**	\brief	Moves the waiters whose ticket is reached out of from, into to (lock held).
+			 */
+			template <class T>
+			static void take(std::vector<std::pair<uint64_t, T> >& from, std::vector<T>& to, uint64_t done) {
+				size_t kept = 0;
+
+				for(auto& w : from) {
+					if (w.first <= done)
+						to.push_back(std::move(w.second));
+					else
+						from[kept++] = std::move(w);
+				}
+
+				from.resize(kept);
+			}
+
+			/**	\brief	Resolves all waiters whose ticket is reached.
+			 */
+			void notify() {
+				std::vector<std::promise<void> > ready;
+				std::vector<std::function<void()> > calls;
+
+				{
+					std::lock_guard<std::mutex> lock(this->m_mutex);
+					const uint64_t done = this->completed.load();
+
+					take(this->promises, ready, done);
+					take(this->callbacks, calls, done);
+					this->waiting.store(this->promises.size() + this->callbacks.size());
+				}
+
+				for(auto& f : calls) f();
+				for(auto& p : ready) p.set_value();
+			}
+
+			/**	\brief	Registers a waiter for ticket (lock held).
+			 *
+			 *	\return	bool
+			 *		Returns false when the ticket is already reached; the waiter is then not registered.
+			 */
+			template <class T>
+			bool enqueue(std::vector<std::pair<uint64_t, T> >& waiters, uint64_t ticket, T&& waiter) {
+				// Counted before reading completed, so a concurrent end() either is seen here or sees the waiter
+				this->waiting.fetch_add(1);
+				if (this->completed.load() >= ticket) {
+					this->waiting.fetch_sub(1);
+					return false;
+				}
+
+				waiters.push_back(std::make_pair(ticket, std::forward<T>(waiter)));
+				return true;
+			}
+
+		public:
+			Settlement() : completed(0), waiting(0) {}
+
+			Settlement(const Settlement&) = delete;
+			Settlement& operator=(const Settlement&) = delete;
+
+			/**	\brief	Finishes the next n units of work (any thread), notifying the waiters they complete.
+			 */
+			inline void end(size_t n = 1) {
+				if (!n) return;
+
+				this->completed.fetch_add(n);
+				if (this->waiting.load() != 0) this->notify();
+			}
+
+			/**	\brief	Gets the amount of units finished so far.
+			 */
+			inline uint64_t finished() const {
+				return this->completed.load(std::memory_order_acquire);
+			}
+
+			/**	\brief	Gets a future that becomes ready once ticket units are finished.
+			 */
+			std::future<void> settled(uint64_t ticket) {
+				std::promise<void> p;
+				std::future<void> f = p.get_future();
+
+				std::unique_lock<std::mutex> lock(this->m_mutex);
+				if (!this->enqueue(this->promises, ticket, std::move(p))) {
+					lock.unlock();
+					p.set_value();
+				}
+
+				return f;
+			}
+
+			/**	\brief	Calls f once ticket units are finished, immediately when that is already the case.
+			 */
+			void onSettled(uint64_t ticket, const std::function<void()>& f) {
+				{
+					std::lock_guard<std::mutex> lock(this->m_mutex);
+					if (this->enqueue(this->callbacks, ticket, std::function<void()>(f))) return;
+				}
+
+				f();
+			}
+	};
+
+}
+
+#endif // SYNCHROTRONSETTLEMENT_HPP
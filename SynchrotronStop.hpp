@@ -0,0 +1,81 @@
+/**
+*	Cooperative cancellation of long running propagation.
+*/
+#ifndef SYNCHROTRONSTOP_HPP
+#define SYNCHROTRONSTOP_HPP
+
+#include <atomic>
+
+namespace Synchrotron {
+
+	/** \brief
+	 *	StopToken lets an engine poll whether its StopSource requested a stop.
+	 *
+	 *	A default constructed token is never stopped. Polling is a single relaxed load.
+	 *
+	 *	A stopped engine keeps the states it evaluated so far. Rolling back is up to
+	 *	the caller: Netlist::load() only returns to the states of the last
+	 *	Netlist::store(), so store() before a run that may have to be undone.
+	 */
+	class StopToken {
+		private:
+			const std::atomic<bool>	*flag;
+
+		public:
+			StopToken() : flag(nullptr) {}
+			explicit StopToken(const std::atomic<bool>* flag) : flag(flag) {}
+
+			/**	\brief	Gets whether a stop can ever be requested through this token.
+			 */
+			inline bool stopPossible() const {
+				return this->flag != nullptr;
+			}
+
+			/**	\brief	Gets whether a stop was requested.
+			 */
+			inline bool stopRequested() const {
+				return this->flag && this->flag->load(std::memory_order_relaxed);
+			}
+	};
+
+	/** \brief
+	 *	StopSource requests a stop from any thread, for instance a deadline watchdog.
+	 *
+	 *	The source has to outlive every token it handed out.
+	 */
+	class StopSource {
+		private:
+			std::atomic<bool>	stopped;
+
+		public:
+			StopSource() : stopped(false) {}
+
+			StopSource(const StopSource&) = delete;
+			StopSource& operator=(const StopSource&) = delete;
+
+			/**	\brief	Gets a token to pass to an engine.
+			 */
+			inline StopToken token() const {
+				return StopToken(&this->stopped);
+			}
+
+			/**	\brief	Asks every holder of a token to stop at its next check.
+			 */
+			inline void requestStop() {
+				this->stopped.store(true, std::memory_order_relaxed);
+			}
+
+			inline bool stopRequested() const {
+				return this->stopped.load(std::memory_order_relaxed);
+			}
+
+			/**	\brief	Withdraws the request, so the source can be reused.
+			 */
+			inline void reset() {
+				this->stopped.store(false, std::memory_order_relaxed);
+			}
+	};
+
+}
+
+#endif // SYNCHROTRONSTOP_HPP
@@ -0,0 +1,283 @@
+/**
+*	Persistent worker threads shared by the parallel propagation engines.
+*/
+#ifndef SYNCHROTRONTHREADPOOL_HPP
+#define SYNCHROTRONTHREADPOOL_HPP
+
+#include "SynchrotronBarrier.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Synchrotron {
+
+	/**	\brief
+	 *	A unit of work for ThreadPool::execute().
+	 *
+	 *	Plain function pointer + context, so scheduling a Task never allocates.
+	 */
+	struct Task {
+		void	(*run)(void* ctx, size_t arg, size_t worker);
+		void	*ctx;
+		size_t	arg;
+	};
+
+	/**	\brief
+	 *	Creating a new SpinBlock(flag) spins until flag is acquired,
+	 *	while leaving the scope conveniently releases it.
+	 */
+	class SpinBlock {
+		public:
+			std::atomic_flag *m_flag;
+			SpinBlock(std::atomic_flag *flag)
+				: m_flag(flag)		{ while (m_flag->test_and_set(std::memory_order_acquire)) std::this_thread::yield();	}
+			~SpinBlock()			{ m_flag->clear(std::memory_order_release);	}
+	};
+
+	/**	\brief
+	 *	Double ended queue of Tasks owned by a single worker.
+	 *
+	 *	The owner pushes and pops at the back (LIFO, cache friendly),
+	 *	other workers steal from the front (FIFO, oldest and largest work first).
+	 *	The ring buffer only grows when full, so a warmed up queue never allocates.
+	 */
+	class WorkQueue {
+		private:
+			std::atomic_flag	flag;
+			std::vector<Task>	ring;
+			size_t				head, count;
+
+			void grow() {
+				std::vector<Task> larger(this->ring.empty() ? 64 : this->ring.size() * 2);
+
+				for(size_t i = 0; i < this->count; i++)
+					larger[i] = this->ring[(this->head + i) % this->ring.size()];
+
+				this->ring.swap(larger);
+				this->head = 0;
+			}
+
+		public:
+			WorkQueue() : ring(64), head(0), count(0) {
+				this->flag.clear();
+			}
+
+			/**	\brief	Pushes t at the back of the queue.
+			 */
+			void push(const Task& t) {
+				SpinBlock lock(&this->flag);
+
+				if (this->count == this->ring.size()) this->grow();
+				this->ring[(this->head + this->count++) % this->ring.size()] = t;
+			}
+
+			/**	\brief	Pops the most recently pushed Task (owner only).
+			 *
+			 *	\return	bool
+			 *		Returns false when the queue was empty.
+			 */
+			bool pop(Task& t) {
+				SpinBlock lock(&this->flag);
+
+				if (this->count == 0) return false;
+				t = this->ring[(this->head + --this->count) % this->ring.size()];
+				return true;
+			}
+
+			/**	\brief	Takes the oldest Task (other workers).
+			 *
+			 *	\return	bool
+			 *		Returns false when the queue was empty.
+			 */
+			bool steal(Task& t) {
+				SpinBlock lock(&this->flag);
+
+				if (this->count == 0) return false;
+				t = this->ring[this->head];
+				this->head = (this->head + 1) % this->ring.size();
+				this->count--;
+				return true;
+			}
+	};
+
+	/** \brief
+	 *	ThreadPool keeps `size() - 1` threads alive between runs;
+	 *	the calling thread always participates as worker 0.
+	 *
+	 *	Two ways of running work are offered:
+	 *	*	run() executes the same kernel on every worker (SPMD),
+	 *		kernels can synchronise all workers with sync().
+	 *	*	execute() runs Tasks with work stealing until none are left.
+	 */
+	class ThreadPool {
+		public:
+			typedef void (*Kernel)(void* ctx, size_t worker);
+
+		private:
+			std::vector<std::thread>	threads;
+			std::vector<WorkQueue>		queues;
+			TreeBarrier					barrier;
+
+			std::mutex					m_mutex;
+			std::condition_variable		wake, done;
+			Kernel						kernel;
+			void						*context;
+			size_t						generation, active;
+			bool						stopping;
+
+			/**	\brief	Tasks spawned but not yet finished during execute().
+			 */
+			std::atomic<size_t>			outstanding;
+
+			void worker(size_t id) {
+				size_t seen = 0;
+
+				for(;;) {
+					Kernel k;
+					void *ctx;
+					{
+						std::unique_lock<std::mutex> lock(this->m_mutex);
+						this->wake.wait(lock, [&]{ return this->stopping || this->generation != seen; });
+						if (this->stopping) return;
+						seen = this->generation;
+						k	= this->kernel;
+						ctx	= this->context;
+					}
+
+					k(ctx, id);
+
+					std::lock_guard<std::mutex> lock(this->m_mutex);
+					if (--this->active == 0) this->done.notify_one();
+				}
+			}
+
+			static void stealKernel(void* ctx, size_t worker) {
+				ThreadPool *pool = static_cast<ThreadPool*>(ctx);
+				const size_t n = pool->size();
+				Task t;
+
+				while (pool->outstanding.load(std::memory_order_acquire) != 0) {
+					bool found = pool->queues[worker].pop(t);
+
+					for(size_t i = 1; !found && i < n; i++)
+						found = pool->queues[(worker + i) % n].steal(t);
+
+					if (found) {
+						t.run(t.ctx, t.arg, worker);
+						pool->outstanding.fetch_sub(1, std::memory_order_acq_rel);
+					} else {
+						std::this_thread::yield();
+					}
+				}
+			}
+
+		public:
+			/**	\brief	Default constructor
+			 *
+			 *	\param	workers
+			 *		Total amount of workers including the caller, 0 uses all hardware threads.
+			 */
+			explicit ThreadPool(size_t workers = 0)
+				: queues(workers ? workers : std::max<size_t>(1, std::thread::hardware_concurrency())),
+				  barrier(queues.size()),
+				  kernel(nullptr), context(nullptr), generation(0), active(0), stopping(false), outstanding(0)
+			{
+				for(size_t i = 1; i < this->queues.size(); i++)
+					this->threads.push_back(std::thread(&ThreadPool::worker, this, i));
+			}
+
+			ThreadPool(const ThreadPool&) = delete;
+			ThreadPool& operator=(const ThreadPool&) = delete;
+
+			/**	\brief	Default destructor
+			 *
+			 *		Stops and joins all threads.
+			 */
+			~ThreadPool() {
+				{
+					std::lock_guard<std::mutex> lock(this->m_mutex);
+					this->stopping = true;
+				}
+				this->wake.notify_all();
+
+				for(auto& t : this->threads) t.join();
+			}
+
+			/**	\brief	Gets the amount of workers, including the calling thread.
+			 */
+			inline size_t size() const {
+				return this->queues.size();
+			}
+
+			/**	\brief	Runs k(ctx, worker) once on every worker and waits for all of them.
+			 *
+			 *	\param	k
+			 *		The kernel to run, worker ids range from 0 to size() - 1.
+			 *	\param	ctx
+			 *		Passed unchanged to k.
+			 */
+			void run(Kernel k, void* ctx) {
+				{
+					std::lock_guard<std::mutex> lock(this->m_mutex);
+					this->kernel	= k;
+					this->context	= ctx;
+					this->active	= this->threads.size();
+					this->generation++;
+				}
+				this->wake.notify_all();
+
+				k(ctx, 0);
+
+				std::unique_lock<std::mutex> lock(this->m_mutex);
+				this->done.wait(lock, [&]{ return this->active == 0; });
+			}
+
+			/**	\brief	Blocks until every worker of the current run() reached sync().
+			 *
+			 *	\param	worker
+			 *		The id of the calling worker.
+			 */
+			inline void sync(size_t worker) {
+				this->barrier.wait(worker);
+			}
+
+			/**	\brief	Schedules a new Task from inside a running Task.
+			 *
+			 *	\param	worker
+			 *		The id of the calling worker, whose queue receives t.
+			 *	\param	t
+			 *		The Task to schedule.
+			 */
+			inline void spawn(size_t worker, const Task& t) {
+				this->outstanding.fetch_add(1, std::memory_order_relaxed);
+				this->queues[worker].push(t);
+			}
+
+			/**	\brief	Runs tasks and everything they spawn() until no work remains.
+			 *
+			 *	The seeds are dealt round robin over all workers,
+			 *	idle workers steal from the others.
+			 *
+			 *	\param	seeds
+			 *		The initial Tasks.
+			 *	\param	count
+			 *		The amount of initial Tasks.
+			 */
+			void execute(const Task* seeds, size_t count) {
+				if (count == 0) return;
+
+				this->outstanding.store(count, std::memory_order_relaxed);
+				for(size_t i = 0; i < count; i++)
+					this->queues[i % this->size()].push(seeds[i]);
+
+				this->run(&ThreadPool::stealKernel, this);
+			}
+	};
+
+}
+
+#endif // SYNCHROTRONTHREADPOOL_HPP
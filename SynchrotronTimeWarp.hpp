@@ -0,0 +1,608 @@
+/**
+*	Optimistic parallel discrete-event simulation (Time Warp).
+*/
+#ifndef SYNCHROTRONTIMEWARP_HPP
+#define SYNCHROTRONTIMEWARP_HPP
+
+#include "SynchrotronNetlist.hpp"
+#include "SynchrotronChannel.hpp"
+#include "SynchrotronEvent.hpp"
+#include "SynchrotronPDES.hpp"
+#include "SynchrotronThreadPool.hpp"
+#include "SynchrotronTrace.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace Synchrotron {
+
+	/** \brief
+	 *	OptimisticEngine simulates the same timed model as ConservativeEngine,
+	 *	but lets every partition run ahead without waiting for promises.
+	 *
+	 *	Each processed event logs the previous value of everything it overwrites
+	 *	(incremental state saving). When an update arrives for a time a partition
+	 *	already passed (a straggler), the partition rolls back: it restores the
+	 *	logged states and retracts the local events it generated. Updates it sent
+	 *	are cancelled lazily: if re-execution sends the very same update again the
+	 *	original stays valid, otherwise an anti-message annihilates it at the
+	 *	receiver (rolling that one back in turn if needed). This keeps rollbacks
+	 *	from echoing around cycles in the netlist.
+	 *
+	 *	Every `gvtInterval` iterations all workers meet to compute the global
+	 *	virtual time (GVT): no rollback can ever reach before it, so the logs
+	 *	of older events are discarded (fossil collection).
+	 *
+	 *	The Observers of the Netlist only hear of committed changes, at fossil
+	 *	collection: never of speculative or rolled back ones. Callbacks therefore
+	 *	come late, on a worker, with the committed state, while the Netlist may
+	 *	already hold newer speculative states.
+	 *
+	 *	\param	bit_width
+	 *		This template argument specifies the width of the internal bitset state.
+	 */
+	template <size_t bit_width>
+	class OptimisticEngine {
+		public:
+			typedef std::bitset<bit_width>	State;
+			typedef Event<bit_width>		Ev;
+
+		private:
+			/**	\brief	An event with a globally unique id, so an anti-message finds its positive twin.
+			 */
+			struct Item {
+				Ev			event;
+				uint64_t	uid;
+
+				inline bool operator< (const Item& other) const {
+					if (other.event > this->event) return true;
+					if (this->event > other.event) return false;
+					return this->uid < other.uid;
+				}
+			};
+
+			struct Message {
+				Item	item;
+				bool	anti;
+			};
+
+			typedef SpscChannel<Message> Channel;
+
+			/**	\brief	One side of a channel; see ConservativeEngine::Link for the backlog.
+			 */
+			struct Link {
+				Channel					*channel;
+				std::vector<Message>	backlog;
+				size_t					flushed;
+			};
+
+			/**	\brief	Previous value of something an event overwrote.
+			 */
+			struct Undo {
+				enum What { Component, Ghost, Projected };
+
+				size_t	what;
+				size_t	index;
+				State	value;
+			};
+
+			/**	\brief	An update sent to another partition, with the event that caused it.
+			 */
+			struct Sent {
+				size_t	link;
+				Item	item;
+				Item	cause;
+			};
+
+			/**	\brief	A processed event with the start of its entries in the logs.
+			 */
+			struct Processed {
+				Item	item;
+				size_t	undo, local, sent;
+			};
+
+			struct Partition {
+				std::set<Item>			pending;
+				std::vector<Processed>	processed;
+
+				std::vector<Undo>		undo;
+				std::vector<Item>		local;		// Events generated for this partition
+				std::vector<Sent>		sent;		// Updates sent to other partitions
+				std::vector<Sent>		lazy;		// Rolled back updates, not cancelled yet
+
+				std::vector<Link>		in, out;
+				std::vector<size_t>		remote;
+				std::vector<State>		ghost;
+
+				uint64_t				sequence;
+				size_t					committed, rolledBack, antiMessages;
+			};
+
+			Netlist<bit_width>		&netlist;
+			std::vector<size_t>		owner;
+			std::vector<SimTime>	delay;
+			std::vector<State>		projected;
+			std::vector<size_t>		remoteOffset, remoteLink;
+
+			std::vector<Partition>	partitions;
+			std::vector<std::unique_ptr<Channel> >	channels;
+
+			SimTime					until, window, gvt;
+			size_t					batch, gvtInterval;
+			ThreadPool				*pool;
+
+			/**	\brief	Per worker lower bound on unprocessed work, reduced into the GVT.
+			 */
+			std::unique_ptr<Padded<SimTime>[]>	minimum;
+			size_t								workers;
+
+			CommitLog<bit_width>	*log;	// One lane per partition, fed by fossil collection
+
+			inline State& ghost(Partition& p, size_t i) {
+				return p.ghost[std::lower_bound(p.remote.begin(), p.remote.end(), i) - p.remote.begin()];
+			}
+
+			inline uint64_t uid(size_t id) {
+				return (uint64_t(id) << 40) | this->partitions[id].sequence++;
+			}
+
+			void send(Partition& p, size_t k, const Message& m) {
+				Link &link = p.out[k];
+
+				if (!link.backlog.empty() || !link.channel->push(m))
+					link.backlog.push_back(m);
+			}
+
+			void flush(Partition& p) {
+				for(auto& link : p.out) {
+					while (link.flushed < link.backlog.size() && link.channel->push(link.backlog[link.flushed]))
+						link.flushed++;
+
+					if (link.flushed == link.backlog.size()) {
+						link.backlog.clear();
+						link.flushed = 0;
+					}
+				}
+			}
+
+			/**	\brief	Undoes every processed event of partition id that is not before bound.
+			 */
+			void rollback(size_t id, const Item& bound) {
+				Partition &p = this->partitions[id];
+
+				while (!p.processed.empty() && !(p.processed.back().item < bound)) {
+					const Processed done = p.processed.back();
+					p.processed.pop_back();
+					p.rolledBack++;
+
+					while (p.undo.size() > done.undo) {
+						const Undo &u = p.undo.back();
+
+						if (u.what == Undo::Component)		this->netlist.setState(u.index, u.value);
+						else if (u.what == Undo::Ghost)		this->ghost(p, u.index) = u.value;
+						else								this->projected[u.index] = u.value;
+
+						p.undo.pop_back();
+					}
+
+					for(size_t k = done.local; k < p.local.size(); k++)
+						p.pending.erase(p.local[k]);
+					p.local.resize(done.local);
+
+					p.lazy.insert(p.lazy.end(), p.sent.begin() + done.sent, p.sent.end());
+					p.sent.resize(done.sent);
+
+					p.pending.insert(done.item);
+				}
+			}
+
+			/**	\brief	Sends anti-messages for rolled back updates whose cause is not after bound,
+			 *	re-execution passed them without sending them again.
+			 */
+			void cancel(Partition& p, const Item* bound) {
+				size_t keep = 0;
+
+				for(size_t k = 0; k < p.lazy.size(); k++) {
+					if (bound && *bound < p.lazy[k].cause) {
+						p.lazy[keep++] = p.lazy[k];
+						continue;
+					}
+
+					const Message anti = { p.lazy[k].item, true };
+					this->send(p, p.lazy[k].link, anti);
+					p.antiMessages++;
+				}
+
+				p.lazy.resize(keep);
+			}
+
+			/**	\brief	Sends update to out link k, unless an identical rolled back update is still valid.
+			 */
+			void sendUpdate(size_t id, size_t k, const Ev& update, const Item& cause) {
+				Partition &p = this->partitions[id];
+
+				for(size_t l = 0; l < p.lazy.size(); l++) {
+					const Sent &old = p.lazy[l];
+
+					if (old.link == k && !(old.item.event > update) && !(update > old.item.event)) {
+						p.sent.push_back(old);
+						p.sent.back().cause = cause;
+						p.lazy.erase(p.lazy.begin() + l);
+						return;
+					}
+				}
+
+				const Sent s = { k, { update, this->uid(id) }, cause };
+				const Message m = { s.item, false };
+				this->send(p, k, m);
+				p.sent.push_back(s);
+			}
+
+			/**	\brief	Moves all received messages into the pending events of partition id.
+			 */
+			void drain(size_t id) {
+				Partition &p = this->partitions[id];
+				Message m;
+
+				for(auto& link : p.in) {
+					while (link.channel->pop(m)) {
+						// A straggler, or the anti-message of something already processed
+						if (!p.processed.empty() && (m.anti ? !(p.processed.back().item < m.item) : m.item < p.processed.back().item))
+							this->rollback(id, m.item);
+
+						if (m.anti)	p.pending.erase(m.item);
+						else		p.pending.insert(m.item);
+					}
+				}
+			}
+
+			void process(size_t id, const Item& item) {
+				Partition &p = this->partitions[id];
+				const Ev &e = item.event;
+				const size_t i = e.index;
+				const Processed done = { item, p.undo.size(), p.local.size(), p.sent.size() };
+
+				if (e.kind == Ev::Update) {
+					if (this->owner[i] == id) {
+						const Undo u = { Undo::Component, i, this->netlist.getState(i) };
+						p.undo.push_back(u);
+						this->netlist.setState(i, e.value);
+					} else {
+						State &g = this->ghost(p, i);
+						const Undo u = { Undo::Ghost, i, g };
+						p.undo.push_back(u);
+						g = e.value;
+					}
+
+					for(const Index *o = this->netlist.outputsBegin(i), *end = this->netlist.outputsEnd(i); o != end; ++o) {
+						if (this->owner[*o] != id) continue;
+
+						const Item evaluate = { { e.time, Ev::Evaluate, *o, State() }, this->uid(id) };
+						p.pending.insert(evaluate);
+						p.local.push_back(evaluate);
+					}
+				} else {
+					State next = this->projected[i];
+					for(const Index *in = this->netlist.inputsBegin(i), *end = this->netlist.inputsEnd(i); in != end; ++in)
+						SynchrotronComponent<bit_width>::fold(next, this->owner[*in] == id ? this->netlist.getState(*in) : this->ghost(p, *in));
+
+					if (next != this->projected[i]) {
+						const Undo u = { Undo::Projected, i, this->projected[i] };
+						p.undo.push_back(u);
+						this->projected[i] = next;
+
+						const Ev update = { later(e.time, this->delay[i]), Ev::Update, i, next };
+						const Item own = { update, this->uid(id) };
+						p.pending.insert(own);
+						p.local.push_back(own);
+
+						for(size_t k = this->remoteOffset[i]; k < this->remoteOffset[i + 1]; k++)
+							this->sendUpdate(id, this->remoteLink[k], update, item);
+					}
+				}
+
+				p.processed.push_back(done);
+				if (!p.lazy.empty()) this->cancel(p, &item);
+			}
+
+			/**	\brief	Discards the logs of every event before gvt.
+			 */
+			void fossilCollect(size_t id, SimTime gvt) {
+				Partition &p = this->partitions[id];
+				size_t keep = 0;
+				while (keep < p.processed.size() && p.processed[keep].item.event.time < gvt) keep++;
+				if (keep == 0) return;
+
+				// Only now are changes final; the first undo entry of an owned update holds the old state
+				const Observers<bit_width> *observers = this->netlist.getObservers();
+				if (this->log || observers) {
+					for(size_t k = 0; k < keep; k++) {
+						const Ev &e = p.processed[k].item.event;
+						if (e.kind != Ev::Update) continue;
+
+						// Evaluations may log nothing, so only updates are sure to own an undo entry
+						const Undo &u = p.undo[p.processed[k].undo];
+						if (u.what != Undo::Component || u.value == e.value) continue;
+
+						if (this->log) this->log->record(id, e.time, e.index, e.value);
+						if (observers) observers->changed(e.index, StateWord<bit_width>::from(e.value));
+					}
+				}
+
+				const Processed first = (keep < p.processed.size())
+										? p.processed[keep]
+										: Processed{ Item(), p.undo.size(), p.local.size(), p.sent.size() };
+
+				p.undo.erase(p.undo.begin(), p.undo.begin() + first.undo);
+				p.local.erase(p.local.begin(), p.local.begin() + first.local);
+				p.sent.erase(p.sent.begin(), p.sent.begin() + first.sent);
+				p.processed.erase(p.processed.begin(), p.processed.begin() + keep);
+
+				for(auto& done : p.processed) {
+					done.undo	-= first.undo;
+					done.local	-= first.local;
+					done.sent	-= first.sent;
+				}
+
+				p.committed += keep;
+			}
+
+			/**	\brief	Synchronous GVT computation, run by every worker at the same time.
+			 */
+			void computeGVT(size_t worker) {
+				const size_t parts = this->partitions.size();
+
+				// 1. Nobody processes anymore; cancel what re-execution can no longer send again
+				this->pool->sync(worker);
+				for(size_t id = worker; id < parts; id += this->workers) {
+					Partition &p = this->partitions[id];
+
+					this->cancel(p, p.pending.empty() ? nullptr : &*p.pending.begin());
+					this->flush(p);
+				}
+				this->pool->sync(worker);
+
+				// 2. Receive everything in flight, rollbacks only add to the lazy lists
+				for(size_t id = worker; id < parts; id += this->workers)
+					this->drain(id);
+				this->pool->sync(worker);
+
+				// 3. Pending events, backlogs and lazy lists now bound all work left
+				SimTime local = never;
+				for(size_t id = worker; id < parts; id += this->workers) {
+					Partition &p = this->partitions[id];
+
+					if (!p.pending.empty()) local = std::min(local, p.pending.begin()->event.time);
+					for(auto& link : p.out)
+						for(size_t k = link.flushed; k < link.backlog.size(); k++)
+							local = std::min(local, link.backlog[k].item.event.time);
+					for(auto& s : p.lazy)
+						local = std::min(local, s.item.event.time);
+				}
+				this->minimum[worker].value = local;
+				this->pool->sync(worker);
+
+				SimTime gvt = never;
+				for(size_t w = 0; w < this->workers; w++)
+					gvt = std::min(gvt, this->minimum[w].value);
+				this->pool->sync(worker);
+
+				if (worker == 0) this->gvt = gvt;
+				for(size_t id = worker; id < parts; id += this->workers)
+					this->fossilCollect(id, gvt);
+				this->pool->sync(worker);
+			}
+
+			static void runKernel(void* ctx, size_t worker) {
+				OptimisticEngine *self = static_cast<OptimisticEngine*>(ctx);
+				const size_t parts = self->partitions.size();
+
+				for(;;) {
+					for(size_t round = 0; round < self->gvtInterval; round++) {
+						for(size_t id = worker; id < parts; id += self->workers) {
+							Partition &p = self->partitions[id];
+							self->flush(p);
+							self->drain(id);
+
+							const SimTime horizon = std::min(self->until, later(self->gvt, self->window));
+							for(size_t n = 0; n < self->batch && !p.pending.empty(); n++) {
+								const Item item = *p.pending.begin();
+								if (item.event.time >= horizon) break;
+
+								p.pending.erase(p.pending.begin());
+								self->process(id, item);
+							}
+						}
+					}
+
+					self->computeGVT(worker);
+					if (self->gvt >= self->until) return;
+				}
+			}
+
+		public:
+			/**	\brief	Default constructor
+			 *
+			 *	\param	netlist
+			 *		The Netlist to simulate; its topology must not change afterwards.
+			 *	\param	partitionOf
+			 *		The partition of every component, see ConservativeEngine::blocks().
+			 *	\param	channelCapacity
+			 *		The amount of messages each channel can hold.
+			 */
+			OptimisticEngine(Netlist<bit_width>& netlist, const std::vector<size_t>& partitionOf, size_t channelCapacity = 1024)
+				: netlist(netlist), owner(partitionOf), delay(netlist.size(), 1),
+				  until(0), window(never), gvt(0), batch(64), gvtInterval(16), pool(nullptr), workers(0), log(nullptr)
+			{
+				const size_t n = netlist.size();
+				const size_t parts = this->owner.empty() ? 0 : *std::max_element(this->owner.begin(), this->owner.end()) + 1;
+				std::vector<size_t> linkOf(parts * parts, size_t(-1));
+
+				this->partitions.resize(parts);
+				for(auto& p : this->partitions)
+					p.sequence = p.committed = p.rolledBack = p.antiMessages = 0;
+
+				for(size_t i = 0; i < n; i++)
+					this->projected.push_back(netlist.getState(i));
+
+				this->remoteOffset.assign(1, 0);
+				for(size_t i = 0; i < n; i++) {
+					const size_t from = this->owner[i];
+
+					for(const Index *o = netlist.outputsBegin(i), *end = netlist.outputsEnd(i); o != end; ++o) {
+						const size_t to = this->owner[*o];
+						if (to == from) continue;
+
+						size_t &link = linkOf[from * parts + to];
+						if (link == size_t(-1)) {
+							this->channels.push_back(std::unique_ptr<Channel>(new Channel(channelCapacity)));
+
+							Link l;
+							l.channel = this->channels.back().get();
+							l.flushed = 0;
+
+							link = this->partitions[from].out.size();
+							this->partitions[from].out.push_back(l);
+							this->partitions[to].in.push_back(l);
+						}
+
+						if (std::find(this->remoteLink.begin() + this->remoteOffset.back(), this->remoteLink.end(), link) == this->remoteLink.end())
+							this->remoteLink.push_back(link);
+
+						this->partitions[to].remote.push_back(i);
+					}
+
+					this->remoteOffset.push_back(this->remoteLink.size());
+				}
+
+				for(auto& p : this->partitions) {
+					std::sort(p.remote.begin(), p.remote.end());
+					p.remote.erase(std::unique(p.remote.begin(), p.remote.end()), p.remote.end());
+
+					for(size_t i : p.remote) p.ghost.push_back(netlist.getState(i));
+				}
+			}
+
+			/**	\brief	Sets the delay of component i (at least 1).
+			 */
+			inline void setDelay(size_t i, SimTime d) {
+				this->delay[i] = d ? d : 1;
+			}
+
+			/**	\brief	Limits how far partitions may run ahead of the GVT (default: unlimited).
+			 */
+			inline void setWindow(SimTime w) {
+				this->window = w;
+			}
+
+			/**	\brief	Sets the amount of events per partition between channel polls,
+			 *	and the amount of such rounds between two GVT computations.
+			 */
+			inline void setIntervals(size_t events, size_t rounds) {
+				this->batch			= events ? events : 1;
+				this->gvtInterval	= rounds ? rounds : 1;
+			}
+
+			/**	\brief	Gets the amount of partitions.
+			 */
+			inline size_t size() const {
+				return this->partitions.size();
+			}
+
+			/**	\brief	Gets the time up to which the simulation ran.
+			 */
+			inline SimTime now() const {
+				return this->until;
+			}
+
+			/**	\brief	Schedules an external change of component i, see ConservativeEngine::schedule().
+			 */
+			void schedule(SimTime t, size_t i, const State& value) {
+				const size_t from = this->owner[i];
+				const Item item = { { std::max(t, this->until), Ev::Update, i, value }, this->uid(from) };
+
+				this->projected[i] = value;
+				this->partitions[from].pending.insert(item);
+
+				// Other partitions aren't running, so their ghosts can be told directly
+				std::vector<size_t> told(1, from);
+				for(const Index *o = this->netlist.outputsBegin(i), *end = this->netlist.outputsEnd(i); o != end; ++o) {
+					if (std::find(told.begin(), told.end(), this->owner[*o]) != told.end()) continue;
+
+					told.push_back(this->owner[*o]);
+					this->partitions[this->owner[*o]].pending.insert(item);
+				}
+			}
+
+			/**	\brief	Enables the deterministic mode.
+			 *
+			 *	Every change of a component state is recorded in log as step `time`,
+			 *	and published in canonical (time, index) order at the end of each run().
+			 *	Changes are recorded once they are committed, so the trace equals the one
+			 *	of a ConservativeEngine.
+			 *
+			 *	\param	log
+			 *		The CommitLog to record in, or nullptr to disable (the default).
+			 */
+			inline void setLog(CommitLog<bit_width>* log) {
+				this->log = log;
+			}
+
+			/**	\brief	Processes all events before time t.
+			 *
+			 *	\return	size_t
+			 *		Returns the total amount of committed events so far.
+			 */
+			size_t run(SimTime t, ThreadPool& pool) {
+				this->until	= std::max(t, this->until);
+				this->pool	= &pool;
+
+				if (this->workers != pool.size()) {
+					this->workers = pool.size();
+					this->minimum.reset(new Padded<SimTime>[this->workers]);
+				}
+
+				if (this->log) this->log->lanes(this->partitions.size());
+
+				pool.run(&OptimisticEngine::runKernel, this);
+				if (this->log) this->log->publish();
+				return this->committed();
+			}
+
+			/**	\brief	Gets the amount of events that can no longer be rolled back.
+			 */
+			size_t committed() const {
+				size_t total = 0;
+				for(auto& p : this->partitions) total += p.committed;
+				return total;
+			}
+
+			/**	\brief	Gets the amount of events that were undone.
+			 */
+			size_t rolledBack() const {
+				size_t total = 0;
+				for(auto& p : this->partitions) total += p.rolledBack;
+				return total;
+			}
+
+			/**	\brief	Gets the amount of anti-messages sent.
+			 */
+			size_t antiMessages() const {
+				size_t total = 0;
+				for(auto& p : this->partitions) total += p.antiMessages;
+				return total;
+			}
+
+			/**	\brief	Gets the last computed global virtual time.
+			 */
+			inline SimTime getGVT() const {
+				return this->gvt;
+			}
+	};
+
+}
+
+#endif // SYNCHROTRONTIMEWARP_HPP
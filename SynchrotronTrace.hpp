@@ -0,0 +1,145 @@
+/**
+*	Canonical ordering of the state changes made by the parallel engines.
+*/
+#ifndef SYNCHROTRONTRACE_HPP
+#define SYNCHROTRONTRACE_HPP
+
+#include "SynchrotronBarrier.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Synchrotron {
+
+	/** \brief
+	 *	One state change: component `index` got `state` during logical `step`.
+	 *
+	 *	What a step is depends on the engine (a level, a wave, a simulated time);
+	 *	it only has to be the same no matter how many threads ran it.
+	 *
+	 *	\param	bit_width
+	 *		This template argument specifies the width of the internal bitset state.
+	 */
+	template <size_t bit_width>
+	struct Commit {
+		uint64_t				step;
+		size_t					index;
+		std::bitset<bit_width>	state;
+
+		inline bool operator< (const Commit& other) const {
+			if (this->step != other.step) return this->step < other.step;
+			return this->index < other.index;
+		}
+	};
+
+	/** \brief
+	 *	CommitLog turns the changes of a parallel engine into one deterministic trace.
+	 *
+	 *	Every lane (a worker, or a partition) appends its changes to its own padded
+	 *	buffer without synchronization. At the end of a batch the engine calls publish(),
+	 *	which merges all lanes and orders them by (step, index), so the trace is
+	 *	bit-identical for any amount of threads.
+	 *
+	 *	Entries hold Netlist indices. Those follow creation order (`Mutex::idx`)
+	 *	only until Netlist::compact(BreadthFirst) or erase() renumbers them, so
+	 *	traces and digests only compare between runs on the same Netlist layout.
+	 *
+	 *	Changes with the same (step, index) must come from a single lane, which is
+	 *	the case for every engine: they keep their order.
+	 *
+	 *	\param	bit_width
+	 *		This template argument specifies the width of the internal bitset state.
+	 */
+	template <size_t bit_width>
+	class CommitLog {
+		public:
+			typedef Commit<bit_width>	Entry;
+
+		private:
+			std::unique_ptr<Padded<std::vector<Entry> >[]>	buffers;
+			size_t											count;
+
+			std::vector<Entry>	entries;
+
+		public:
+			/**	\brief	Default constructor
+			 */
+			CommitLog() : count(0) {}
+
+			/**	\brief	Makes sure there are at least n lanes; only call between batches.
+			 */
+			void lanes(size_t n) {
+				if (n <= this->count) return;
+
+				std::unique_ptr<Padded<std::vector<Entry> >[]> grown(new Padded<std::vector<Entry> >[n]);
+				for(size_t l = 0; l < this->count; l++)
+					grown[l].value.swap(this->buffers[l].value);
+
+				this->buffers.swap(grown);
+				this->count = n;
+			}
+
+			/**	\brief	Records a change on lane.
+			 */
+			inline void record(size_t lane, uint64_t step, size_t index, const std::bitset<bit_width>& state) {
+				const Entry e = { step, index, state };
+				this->buffers[lane].value.push_back(e);
+			}
+
+			/**	\brief	Appends the changes recorded since the last call to the trace, in canonical order.
+			 *
+			 *	\return	size_t
+			 *		Returns the amount of changes published.
+			 */
+			size_t publish() {
+				const size_t first = this->entries.size();
+
+				for(size_t l = 0; l < this->count; l++) {
+					std::vector<Entry> &buffer = this->buffers[l].value;
+					this->entries.insert(this->entries.end(), buffer.begin(), buffer.end());
+					buffer.clear();
+				}
+
+				std::stable_sort(this->entries.begin() + first, this->entries.end());
+				return this->entries.size() - first;
+			}
+
+			/**	\brief	Gets all published changes.
+			 */
+			inline const std::vector<Entry>& trace() const {
+				return this->entries;
+			}
+
+			/**	\brief	Forgets all published changes.
+			 */
+			inline void clear() {
+				this->entries.clear();
+			}
+
+			/**	\brief	Hashes the published trace (FNV-1a), to compare runs cheaply.
+			 *
+			 *	The hash covers Netlist indices: compare it between runs on the same layout only.
+			 */
+			uint64_t digest() const {
+				uint64_t h = 14695981039346656037ULL;
+
+				for(const Entry& e : this->entries) {
+					const uint64_t words[2] = { e.step, uint64_t(e.index) };
+					for(uint64_t w : words)
+						for(size_t b = 0; b < 64; b += 8)
+							h = (h ^ ((w >> b) & 0xFF)) * 1099511628211ULL;
+
+					for(size_t b = 0; b < bit_width; b++)
+						h = (h ^ uint64_t(e.state[b])) * 1099511628211ULL;
+				}
+
+				return h;
+			}
+	};
+
+}
+
+#endif // SYNCHROTRONTRACE_HPP
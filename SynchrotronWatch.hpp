@@ -0,0 +1,252 @@
+/**
+*	Watchpoints: conditions over component states, checked once per step.
+*/
+#ifndef SYNCHROTRONWATCH_HPP
+#define SYNCHROTRONWATCH_HPP
+
+#include "SynchrotronDirty.hpp"
+#include "SynchrotronNetlist.hpp"
+#include "SynchrotronObserver.hpp"
+
+#include <bitset>
+#include <cstdint>
+#include <initializer_list>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace Synchrotron {
+
+	/** \brief
+	 *	Watchpoints stop a simulation on conditions like "PC == 0x1234 and flag Z set".
+	 *
+	 *	A watchpoint is a conjunction of conditions `(state & mask) == value`, each
+	 *	on one component. They are compiled into native state words when added, so
+	 *	checking one costs an AND and a compare per condition.
+	 *
+	 *	Evaluations that change a referenced component mark the watchpoints that
+	 *	reference it (through Observers); check(), called once per step, only looks
+	 *	at the marked ones. Components no watchpoint refers to cost nothing, and
+	 *	dozens of watchpoints on rarely changing state cost close to nothing.
+	 *
+	 *	A watchpoint triggers when its condition becomes true, not on every step
+	 *	it stays true. Only what Observers see is seen: states set from outside
+	 *	(setState(), an Ingress) do not mark watchpoints until re-evaluated.
+	 *	Marking takes a lock, so parallel engines may mark from their workers;
+	 *	check() must not run at the same time. ClockScheduler checks them after
+	 *	every step (setWatchpoints()), with the other engines call check() after
+	 *	a run, which sees the conditions at its end.
+	 *
+	 *	\param	bit_width
+	 *		This template argument specifies the width of the internal bitset state.
+	 */
+	template <size_t bit_width>
+	class Watchpoints {
+		public:
+			typedef std::bitset<bit_width>					State;
+			typedef typename StateWord<bit_width>::type		Word;
+			typedef size_t									Id;
+
+			/**	\brief	One condition `(state & mask) == value` on the component h refers to.
+			 */
+			struct Condition {
+				Handle	component;
+				State	mask, value;
+			};
+
+			/**	\brief	Condition that the whole state of h equals value.
+			 */
+			static inline Condition equals(const Handle& h, const State& value) {
+				const Condition c = { h, State().set(), value };
+				return c;
+			}
+
+			/**	\brief	Condition that the bits of h selected by mask equal those of value.
+			 */
+			static inline Condition bits(const Handle& h, const State& mask, const State& value) {
+				const Condition c = { h, mask, value };
+				return c;
+			}
+
+			/**	\brief	Bookkeeping of one watchpoint.
+			 */
+			struct Watch {
+				Index		first, last;	// Its conditions in terms[first .. last)
+				bool		enabled;
+				bool		holds;			// Whether the condition was true at the last check
+				uint64_t	hits;			// Times the condition became true
+			};
+
+		private:
+			/**	\brief	A compiled condition, value already masked.
+			 */
+			struct Term {
+				Handle	component;
+				Word	mask, value;
+			};
+
+			Netlist<bit_width>		&netlist;
+			Observers<bit_width>	&observers;
+
+			std::vector<Watch>		watches;
+			std::vector<Term>		terms;
+
+			/**	\brief	Every watched component, the watchpoints referring to it and its observer.
+			 */
+			std::vector<Handle>					components;
+			std::vector<std::vector<Index> >	users;
+			std::vector<typename Observers<bit_width>::Id>	observed;
+
+			DirtySet				pending;
+			std::mutex				m_mutex;	// Guards pending against workers marking at once
+			std::vector<Id>			triggered;
+
+			/**	\brief	Marks the watchpoints that refer to watched component slot (any thread).
+			 */
+			inline void touch(size_t slot) {
+				std::lock_guard<std::mutex> lock(this->m_mutex);
+				for(Index w : this->users[slot]) this->pending.mark(w);
+			}
+
+			/**	\brief	Gets the slot of the watched component h, watching it first if needed.
+			 */
+			size_t slotOf(const Handle& h) {
+				for(size_t k = 0; k < this->components.size(); k++)
+					if (this->components[k] == h) return k;
+
+				const size_t slot = this->components.size();
+				this->components.push_back(h);
+				this->users.push_back(std::vector<Index>());
+
+				const size_t i = this->netlist.indexOf(h);
+				this->observed.push_back(i == Netlist<bit_width>::npos ? Id(-1)
+					: this->observers.watch(i, [this, slot](size_t, const State&) { this->touch(slot); }));
+				return slot;
+			}
+
+			/**	\brief	Evaluates all conditions of watchpoint w.
+			 */
+			bool evaluate(const Watch& w) const {
+				for(Index t = w.first; t < w.last; t++) {
+					const Term &term = this->terms[t];
+					const size_t i = this->netlist.indexOf(term.component);
+					if (i == Netlist<bit_width>::npos) return false;
+
+					Word state = this->netlist.getWord(i);
+					state &= term.mask;
+					if (state != term.value) return false;
+				}
+
+				return true;
+			}
+
+		public:
+			/**	\brief	Default constructor
+			 *
+			 *	\param	netlist
+			 *		The Netlist whose states the conditions refer to.
+			 *	\param	observers
+			 *		The registry changes are learned through; it gets attached to netlist.
+			 *		Pass the one netlist already notifies, if any, so its callbacks keep running:
+			 *		another one throws std::invalid_argument.
+			 */
+			Watchpoints(Netlist<bit_width>& netlist, Observers<bit_width>& observers)
+				: netlist(netlist), observers(observers)
+			{
+				if (this->netlist.getObservers() && this->netlist.getObservers() != &observers)
+					throw std::invalid_argument("Watchpoints: netlist already notifies other Observers");
+
+				this->netlist.setObservers(&observers);
+			}
+
+			Watchpoints(const Watchpoints&) = delete;
+			Watchpoints& operator=(const Watchpoints&) = delete;
+
+			~Watchpoints() {
+				for(auto id : this->observed)
+					if (id != Id(-1)) this->observers.unwatch(id);
+			}
+
+			/**	\brief	Adds a watchpoint that triggers once all conditions hold.
+			 *
+			 *	It is checked at the next check(), so a condition that already holds triggers then.
+			 *
+			 *	\return	Id
+			 *		Returns the id of the new watchpoint.
+			 */
+			Id add(std::initializer_list<Condition> conditions) {
+				const Id id = this->watches.size();
+				const Watch w = { Index(this->terms.size()), Index(this->terms.size() + conditions.size()), true, false, 0 };
+
+				for(const Condition& c : conditions) {
+					const Term t = { c.component, StateWord<bit_width>::from(c.mask), StateWord<bit_width>::from(c.value & c.mask) };
+					this->terms.push_back(t);
+
+					const size_t slot = this->slotOf(c.component);
+					this->users[slot].push_back(Index(id));
+				}
+
+				this->watches.push_back(w);
+				this->triggered.reserve(this->watches.size());
+
+				if (this->watches.size() > this->pending.capacity()) {
+					this->pending.resize(2 * this->watches.size());
+					for(size_t k = 0; k < this->watches.size(); k++) this->pending.mark(k);
+				}
+
+				this->pending.mark(id);
+				return id;
+			}
+
+			/**	\brief	Enables or disables watchpoint id; a disabled one never triggers.
+			 */
+			void setEnabled(Id id, bool enabled) {
+				this->watches[id].enabled = enabled;
+				this->pending.mark(id);
+			}
+
+			/**	\brief	Gets watchpoint id.
+			 */
+			inline const Watch& watchpoint(Id id) const {
+				return this->watches[id];
+			}
+
+			/**	\brief	Gets the amount of watchpoints.
+			 */
+			inline size_t size() const {
+				return this->watches.size();
+			}
+
+			/**	\brief	Checks the watchpoints whose components changed since the last check.
+			 *
+			 *	\return	size_t
+			 *		Returns the amount of watchpoints that triggered.
+			 */
+			size_t check() {
+				this->triggered.clear();
+
+				for(size_t id = this->pending.pop(); id != DirtySet::npos; id = this->pending.pop()) {
+					Watch &w = this->watches[id];
+					const bool holds = w.enabled && this->evaluate(w);
+
+					if (holds && !w.holds) {
+						w.hits++;
+						this->triggered.push_back(id);
+					}
+
+					w.holds = holds;
+				}
+
+				return this->triggered.size();
+			}
+
+			/**	\brief	Gets the watchpoints that triggered at the last check(), in id order.
+			 */
+			inline const std::vector<Id>& hits() const {
+				return this->triggered;
+			}
+	};
+
+}
+
+#endif // SYNCHROTRONWATCH_HPP
@@ -0,0 +1,125 @@
+/**
+*	Native storage for component states, selected by bit width at compile time.
+*/
+#ifndef SYNCHROTRONWORD_HPP
+#define SYNCHROTRONWORD_HPP
+
+#include <bitset>
+#include <cstdint>
+#include <type_traits>
+
+namespace Synchrotron {
+
+	/** \brief
+	 *	Fixed array of 64-bit words for states wider than 64 bits.
+	 *
+	 *	The operators are plain loops over `word`, which compilers unroll
+	 *	and vectorize.
+	 *
+	 *	\param	words
+	 *		The amount of 64-bit words.
+	 */
+	template <size_t words>
+	struct WordArray {
+		uint64_t word[words];
+
+		inline WordArray& operator|= (const WordArray& other) {
+			for(size_t k = 0; k < words; k++) this->word[k] |= other.word[k];
+			return *this;
+		}
+
+		inline WordArray& operator&= (const WordArray& other) {
+			for(size_t k = 0; k < words; k++) this->word[k] &= other.word[k];
+			return *this;
+		}
+
+		inline WordArray& operator^= (const WordArray& other) {
+			for(size_t k = 0; k < words; k++) this->word[k] ^= other.word[k];
+			return *this;
+		}
+
+		inline bool operator== (const WordArray& other) const {
+			uint64_t diff = 0;
+			for(size_t k = 0; k < words; k++) diff |= this->word[k] ^ other.word[k];
+			return diff == 0;
+		}
+
+		inline bool operator!= (const WordArray& other) const {
+			return !(*this == other);
+		}
+	};
+
+	/** \brief
+	 *	StateWord selects the smallest native type that holds bit_width bits:
+	 *	`uint8_t` .. `uint64_t` up to 64 bits, a WordArray beyond that.
+	 *
+	 *	On native types the fold (`|=`) and the change test (`!=`) are single
+	 *	instructions. Bits above bit_width are always zero.
+	 *
+	 *	\param	bit_width
+	 *		This template argument specifies the width of the internal bitset state.
+	 */
+	template <size_t bit_width>
+	struct StateWord {
+		typedef typename std::conditional<(bit_width <=  8), uint8_t,
+				typename std::conditional<(bit_width <= 16), uint16_t,
+				typename std::conditional<(bit_width <= 32), uint32_t,
+				typename std::conditional<(bit_width <= 64), uint64_t,
+					WordArray<(bit_width + 63) / 64> >::type>::type>::type>::type type;
+
+		static const bool native = (bit_width <= 64);
+
+		/**	\brief	Clears the bits above bit_width, in case the fold set them.
+		 */
+		static inline void mask(type& w) {
+			mask(w, std::integral_constant<bool, native>());
+		}
+
+		static inline type from(const std::bitset<bit_width>& b) {
+			return from(b, std::integral_constant<bool, native>());
+		}
+
+		static inline std::bitset<bit_width> to(const type& w) {
+			return to(w, std::integral_constant<bool, native>());
+		}
+
+		private:
+			static inline void mask(type& w, std::true_type) {
+				if (bit_width % (8 * sizeof(type))) w &= type((uint64_t(1) << (bit_width % 64)) - 1);
+			}
+
+			static inline void mask(type& w, std::false_type) {
+				if (bit_width % 64) w.word[bit_width / 64] &= (uint64_t(1) << (bit_width % 64)) - 1;
+			}
+
+			static inline type from(const std::bitset<bit_width>& b, std::true_type) {
+				return type(b.to_ullong());
+			}
+
+			static inline type from(const std::bitset<bit_width>& b, std::false_type) {
+				const std::bitset<bit_width> low(~uint64_t(0));
+				type w;
+
+				for(size_t k = 0; k < (bit_width + 63) / 64; k++)
+					w.word[k] = ((b >> (64 * k)) & low).to_ullong();
+
+				return w;
+			}
+
+			static inline std::bitset<bit_width> to(const type& w, std::true_type) {
+				return std::bitset<bit_width>((unsigned long long) w);
+			}
+
+			static inline std::bitset<bit_width> to(const type& w, std::false_type) {
+				std::bitset<bit_width> b;
+
+				for(size_t k = (bit_width + 63) / 64; k--;)
+					b = (b << 64) | std::bitset<bit_width>(w.word[k]);
+
+				return b;
+			}
+	};
+
+}
+
+#endif // SYNCHROTRONWORD_HPP
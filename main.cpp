@@ -1,6 +1,7 @@
 #include <iostream>
 #include <stdio.h>
 #include <vector>
+#include <chrono>
 
 #define BSTR(STRB)	( (STRB) ? "true" : "false" )
 
@@ -35,9 +36,24 @@
 */
 
 //#define TEST_PERFORMANCE
+//#define TEST_BARRIER
+//#define TEST_CHANNEL
+//#define TEST_FALSE_SHARING
+//#define TEST_ALLOCATIONS
+//#define TEST_HYBRID
+//#define TEST_ADAPTIVE
+//#define TEST_PACED
+//#define TEST_PDES
+//#define TEST_DETERMINISM
+//#define TEST_PACKED
+//#define TEST_WATCHPOINTS
+//#define TEST_INGRESS
 #define ELEMENTS	10000
 #define TIMES		10
 #define USE_SYNC	6
+#define ROUNDS		100000
+#define SWEEPS		200
+#define WARMUP		10
 
 #include "SynchrotronComponent.hpp"				// 1
 #include "SynchrotronComponentList.hpp"			// 2
@@ -45,6 +61,9 @@
 #include "SynchrotronComponentVector.hpp"		// 4
 #include "SynchrotronComponentSetInsertEnd.hpp"	// 5
 #include "SynchrotronComponentSetSort.hpp"		// 6
+#include "SynchrotronThreadPool.hpp"
+#include "SynchrotronChannel.hpp"
+#include "SynchrotronNetlist.hpp"
 
 using namespace Synchrotron;
 
@@ -73,8 +92,961 @@ void printResults(std::vector<size_t>& v) {
 	printf("Average time: %4d milliseconds :: (min= %4d, max= %4d)\n", (sum / size), min, max);
 }
 
+#ifdef TEST_BARRIER
+template <class Barrier>
+void barrierKernel(void* ctx, size_t worker) {
+	Barrier *barrier = static_cast<Barrier*>(ctx);
+	for (int i = ROUNDS; i--;)
+		barrier->wait(worker);
+}
+
+template <class Barrier>
+double timeBarrier(ThreadPool& pool, Barrier& barrier) {
+	auto t1 = std::chrono::high_resolution_clock::now();
+	pool.run(&barrierKernel<Barrier>, &barrier);
+	auto t2 = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(t2-t1).count() / double(ROUNDS);
+}
+
+void testBarrier() {
+	const size_t cores = std::max<size_t>(1, std::thread::hardware_concurrency());
+
+	std::cout << "Barrier cost per wait() (" << ROUNDS << " rounds)\n";
+	printf("| Workers | SenseBarrier (ns) | TreeBarrier (ns) |\n");
+	for (size_t n = 1; n <= cores; n = (n * 2 > cores && n != cores) ? cores : n * 2) {
+		ThreadPool		pool(n);
+		SenseBarrier	sense(n);
+		TreeBarrier		tree(n);
+
+		printf("| %7d | %17.1f | %16.1f |\n", int(n), timeBarrier(pool, sense), timeBarrier(pool, tree));
+	}
+}
+#endif // TEST_BARRIER
+
+#ifdef TEST_CHANNEL
+// A state change as the engines pass them: component index and new state
+struct Record {
+	uint32_t		index;
+	std::bitset<16>	state;
+};
+
+template <class Channel>
+struct Pipe {
+	Channel	channel;
+	size_t	producers;
+
+	Pipe(size_t producers) : channel(1024), producers(producers) {}
+};
+
+// Worker 0 consumes, workers 1..producers each push ROUNDS records
+template <class Channel>
+void throughputKernel(void* ctx, size_t worker) {
+	Pipe<Channel> *pipe = static_cast<Pipe<Channel>*>(ctx);
+	Record r = { uint32_t(worker), std::bitset<16>(1) };
+
+	if (worker == 0) {
+		for (size_t n = ROUNDS * pipe->producers; n;) {
+			if (pipe->channel.pop(r)) n--;
+			else std::this_thread::yield();
+		}
+	} else if (worker <= pipe->producers) {
+		for (int i = ROUNDS; i--;)
+			while (!pipe->channel.push(r)) std::this_thread::yield();
+	}
+}
+
+template <class Channel>
+double timeThroughput(size_t producers) {
+	ThreadPool		pool(producers + 1);
+	Pipe<Channel>	pipe(producers);
+
+	auto t1 = std::chrono::high_resolution_clock::now();
+	pool.run(&throughputKernel<Channel>, &pipe);
+	auto t2 = std::chrono::high_resolution_clock::now();
+	return ROUNDS * producers / (std::chrono::duration_cast<std::chrono::nanoseconds>(t2-t1).count() / 1e3);
+}
+
+struct PingPong {
+	SpscChannel<Record>	ping, pong;
+};
+
+// Worker 0 sends a record, worker 1 bounces it back
+void latencyKernel(void* ctx, size_t worker) {
+	PingPong *pp = static_cast<PingPong*>(ctx);
+	Record r = { uint32_t(worker), std::bitset<16>(1) };
+
+	for (int i = ROUNDS; i--;) {
+		if (worker == 0) {
+			pp->ping.push(r);
+			while (!pp->pong.pop(r)) std::this_thread::yield();
+		} else if (worker == 1) {
+			while (!pp->ping.pop(r)) std::this_thread::yield();
+			pp->pong.push(r);
+		}
+	}
+}
+
+void testChannel() {
+	const size_t cores = std::max<size_t>(2, std::thread::hardware_concurrency());
+
+	std::cout << "Channel throughput (" << ROUNDS << " records per producer, " << sizeof(Record) << " bytes each)\n";
+	printf("| Channel | Producers | Records/us |\n");
+	printf("| SPSC    | %9d | %10.1f |\n", 1, timeThroughput<SpscChannel<Record> >(1));
+	for (size_t n = 1; n < cores; n = (n * 2 >= cores && n != cores - 1) ? cores - 1 : n * 2)
+		printf("| MPSC    | %9d | %10.1f |\n", int(n), timeThroughput<MpscChannel<Record> >(n));
+
+	ThreadPool	pool(2);
+	PingPong	pp;
+
+	auto t1 = std::chrono::high_resolution_clock::now();
+	pool.run(&latencyKernel, &pp);
+	auto t2 = std::chrono::high_resolution_clock::now();
+	printf("SPSC one way latency: %.1f ns\n", std::chrono::duration_cast<std::chrono::nanoseconds>(t2-t1).count() / (2.0 * ROUNDS));
+}
+#endif // TEST_CHANNEL
+
+#ifdef TEST_FALSE_SHARING
+struct Sweep {
+	Netlist<16>						*netlist;
+	std::vector<std::vector<size_t> >	work;	// Components per worker
+};
+
+// Every worker re-evaluates (and so rewrites the state of) its own components.
+// Only components with inputs are swept: the source they read is never written
+// during the run, so workers share cache lines but no data.
+void sweepKernel(void* ctx, size_t worker) {
+	Sweep *sweep = static_cast<Sweep*>(ctx);
+	const std::vector<size_t> &work = sweep->work[worker];
+
+	for (int r = SWEEPS; r--;)
+		for (size_t i : work)
+			sweep->netlist->evaluate(i);
+}
+
+double timeSweep(ThreadPool& pool, Netlist<16>& netlist, const std::vector<size_t>& workerOf) {
+	Sweep sweep = { &netlist, std::vector<std::vector<size_t> >(pool.size()) };
+	size_t swept = 0;
+	for (size_t i = 0; i < workerOf.size(); i++)
+		if (netlist.inputsBegin(i) != netlist.inputsEnd(i)) {
+			sweep.work[workerOf[i]].push_back(i);
+			swept++;
+		}
+
+	auto t1 = std::chrono::high_resolution_clock::now();
+	pool.run(&sweepKernel, &sweep);
+	auto t2 = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(t2-t1).count() / double(SWEEPS * swept);
+}
+
+void testFalseSharing() {
+	const size_t cores = std::max<size_t>(1, std::thread::hardware_concurrency());
+
+	// One source driving a single wide level
+	SynchrotronComponent<16> source(1);
+	std::vector<SynchrotronComponent<16>*> level;
+	for (int i = ELEMENTS * 4; i--;)
+		level.push_back(new SynchrotronComponent<16>(0));
+	for (auto c : level)
+		c->addInput(source);
+
+	Netlist<16> netlist(level);
+
+	std::cout << "Parallel evaluation of " << netlist.size() << " components (" << SWEEPS << " sweeps)\n";
+	printf("| Workers | Interleaved (ns/eval) | Line blocks (ns/eval) |\n");
+	for (size_t n = 1; n <= cores; n = (n * 2 > cores && n != cores) ? cores : n * 2) {
+		ThreadPool pool(n);
+		std::vector<size_t> interleaved(netlist.size());
+		for (size_t i = 0; i < interleaved.size(); i++) interleaved[i] = i % n;
+
+		printf("| %7d | %21.2f | %21.2f |\n", int(n), timeSweep(pool, netlist, interleaved), timeSweep(pool, netlist, netlist.blocks(n)));
+	}
+
+	for (auto c : level) delete c;
+}
+#endif // TEST_FALSE_SHARING
+
+#ifdef TEST_ALLOCATIONS
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <new>
+
+#include "SynchrotronDataflow.hpp"
+#include "SynchrotronEventDriven.hpp"
+#include "SynchrotronLevelized.hpp"
+#include "SynchrotronObserver.hpp"
+
+// GCC inlines free() into the callers of delete, then takes it for a mismatch with their new
+#if defined(__GNUC__)
+	#define NOINLINE	__attribute__((noinline))
+#else
+	#define NOINLINE
+#endif
+
+// Every heap allocation of the program passes through here
+std::atomic<bool>	counting(false);
+std::atomic<size_t>	allocations(0);
+
+NOINLINE void* allocate(size_t size) {
+	if (counting.load(std::memory_order_relaxed))
+		allocations.fetch_add(1, std::memory_order_relaxed);
+
+	if (void *p = std::malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+
+NOINLINE void release(void* p) noexcept {
+	std::free(p);
+}
+
+// The array and sized forms too, so no deallocation of the library frees what ours allocated
+void* operator new(size_t size)						{ return allocate(size);	}
+void* operator new[](size_t size)					{ return allocate(size);	}
+void operator delete(void* p) noexcept				{ release(p);				}
+void operator delete[](void* p) noexcept			{ release(p);				}
+void operator delete(void* p, size_t) noexcept		{ release(p);				}
+void operator delete[](void* p, size_t) noexcept	{ release(p);				}
+
+// Runs wave WARMUP times, then counts the allocations of TIMES more waves
+size_t steadyAllocations(const std::function<void(size_t)>& wave) {
+	for (size_t k = 0; k < WARMUP; k++) wave(k);
+
+	allocations.store(0);
+	counting.store(true);
+	for (size_t k = WARMUP; k < WARMUP + TIMES; k++) wave(k);
+	counting.store(false);
+
+	return allocations.load();
+}
+
+int testAllocations() {
+	// A source driving a binary tree, with one back edge closing a cycle
+	std::vector<SynchrotronComponent<16>*> c;
+	for (int i = 0; i < ELEMENTS; i++)
+		c.push_back(new SynchrotronComponent<16>(0));
+	for (int i = 1; i < ELEMENTS; i++)
+		c[i]->addInput(*c[(i - 1) / 2]);
+	c[1]->addInput(*c[ELEMENTS - 1]);
+
+	Netlist<16> netlist(c);
+	ThreadPool pool(2);
+	EventDrivenEngine<16> events(netlist);
+	DataflowExecutor<16> dataflow(netlist, pool);
+	LevelizedEngine<16> levelized(netlist);
+
+	// Every wave starts from cleared states, so each one propagates through the whole tree
+	auto reset = [&](size_t k) {
+		for (size_t i = 0; i < netlist.size(); i++) netlist.setState(i, 0);
+		netlist.setState(0, std::bitset<16>(1 << (k % 16)));
+	};
+
+	size_t failed = 0;
+	auto report = [&](const char* name, size_t count) {
+		printf("%-28s %4d allocations in %d waves\n", name, int(count), TIMES);
+		failed += count;
+	};
+
+	report("emit()", steadyAllocations([&](size_t k) {
+		for (auto x : c) x->setState(0);
+		c[0]->setState(std::bitset<16>(1 << (k % 16)));
+		c[0]->emit();
+	}));
+	report("EventDrivenEngine::emit()", steadyAllocations([&](size_t k) {
+		reset(k);
+		events.emit(*c[0], netlist.getState(0));
+	}));
+	report("DataflowExecutor::emit()", steadyAllocations([&](size_t k) {
+		reset(k);
+		dataflow.emit(*c[0], netlist.getState(0));
+	}));
+	report("LevelizedEngine::step()", steadyAllocations([&](size_t k) {
+		reset(k);
+		levelized.step();
+	}));
+	report("LevelizedEngine::step(pool)", steadyAllocations([&](size_t k) {
+		reset(k);
+		levelized.step(pool);
+	}));
+
+	// A monitor on every 64th component, each callback checking it is called for its own component
+	struct Monitor { const Netlist<16> *netlist; size_t seen, misses; } monitor = { &netlist, 0, 0 };
+	Observers<16> observers;
+	std::vector<Handle> watched;
+	for (size_t i = 0; i < netlist.size(); i += 64) {
+		const Handle h = netlist.handle(i);
+		watched.push_back(h);
+		observers.watch(i, [&monitor, h](size_t i, const std::bitset<16>&) {
+			monitor.seen++;
+			monitor.misses += (monitor.netlist->indexOf(h) != i);
+		});
+	}
+
+	// Propagates wave k with engine, counting the waves whose callbacks did not match the changed watched components
+	size_t wrong = 0;
+	std::vector<std::bitset<16> > before(watched.size());
+	auto observedWave = [&](EventDrivenEngine<16>& engine, size_t k) {
+		for (size_t i = 0; i < netlist.size(); i++) netlist.setState(i, 0);
+		const size_t source = netlist.indexOf(c[0]);
+		netlist.setState(source, std::bitset<16>(1 << (k % 16)));
+
+		for (size_t w = 0; w < watched.size(); w++)
+			before[w] = netlist.valid(watched[w]) ? netlist.getState(netlist.indexOf(watched[w])) : 0;
+
+		monitor.seen = monitor.misses = 0;
+		engine.emit(*c[0], netlist.getState(source));
+
+		size_t changes = 0;
+		for (size_t w = 0; w < watched.size(); w++)
+			changes += netlist.valid(watched[w]) && netlist.getState(netlist.indexOf(watched[w])) != before[w];
+
+		wrong += (monitor.seen != changes || monitor.misses != 0);
+	};
+
+	netlist.setObservers(&observers);
+	report("EventDrivenEngine, observed", steadyAllocations([&](size_t k) {
+		observedWave(events, k);
+	}));
+
+	// Indices move on erase() and compact(); the callbacks must follow their components
+	const size_t callbacks = observers.size();
+	netlist.erase(watched[1]);
+	netlist.erase(netlist.handle(netlist.indexOf(watched[2]) + 1));
+	netlist.compact(Netlist<16>::BreadthFirst);
+
+	EventDrivenEngine<16> rebuilt(netlist);
+	for (size_t k = 0; k < TIMES; k++) observedWave(rebuilt, k);
+	netlist.setObservers(nullptr);
+
+	printf("Observers: %d of %d waves miscounted, %d of %d callbacks left after erase()\n",
+		int(wrong), int(WARMUP + 2 * TIMES), int(observers.size()), int(callbacks));
+	failed += wrong + (observers.size() != callbacks - 1);
+
+	for (auto x : c) delete x;
+
+	printf(failed ? "FAILED: steady state propagation allocated or missed changes\n" : "OK: steady state propagation is allocation free\n");
+	return failed ? 1 : 0;
+}
+#endif // TEST_ALLOCATIONS
+
+#ifdef TEST_HYBRID
+#include "SynchrotronEventDriven.hpp"
+#include "SynchrotronHybrid.hpp"
+
+// Average time of one propagation from component 0, starting from cleared states
+template <class Engine>
+double timePropagation(Netlist<16>& netlist, Engine& engine) {
+	double total = 0;
+
+	for (int r = 0; r < TIMES; r++) {
+		for (size_t i = 0; i < netlist.size(); i++) netlist.setState(i, 0);
+
+		auto t1 = std::chrono::high_resolution_clock::now();
+		engine.emit(*netlist.component(0), std::bitset<16>(1 << (r % 16)));
+		auto t2 = std::chrono::high_resolution_clock::now();
+		total += std::chrono::duration_cast<std::chrono::nanoseconds>(t2-t1).count();
+	}
+
+	return total / TIMES / 1e3;
+}
+
+void testHybrid() {
+	// Shallow: one source with ELEMENTS outputs; deep: a chain of ELEMENTS * 100
+	std::vector<SynchrotronComponent<16>*> shallow, deep;
+	for (int i = 0; i <= ELEMENTS; i++) shallow.push_back(new SynchrotronComponent<16>(0));
+	for (int i = 1; i <= ELEMENTS; i++) shallow[i]->addInput(*shallow[0]);
+	for (int i = 0; i < ELEMENTS * 100; i++) deep.push_back(new SynchrotronComponent<16>(0));
+	for (int i = 1; i < ELEMENTS * 100; i++) deep[i]->addInput(*deep[i - 1]);
+
+	Netlist<16> wide(shallow), chain(deep);
+	EventDrivenEngine<16> wideEvents(wide), chainEvents(chain);
+	HybridEngine<16> wideHybrid(wide), chainHybrid(chain);
+
+	printf("| Netlist (components) | Hybrid (us) | Event driven (us) |\n");
+	printf("| Fan out (%9d) | %11.1f | %17.1f |\n", int(wide.size()), timePropagation(wide, wideHybrid), timePropagation(wide, wideEvents));
+	printf("| Chain   (%9d) | %11.1f | %17.1f |\n", int(chain.size()), timePropagation(chain, chainHybrid), timePropagation(chain, chainEvents));
+
+	for (auto c : shallow) delete c;
+	for (auto c : deep) delete c;
+}
+#endif // TEST_HYBRID
+
+#ifdef TEST_ADAPTIVE
+#include "SynchrotronAdaptive.hpp"
+
+int testAdaptive() {
+	// A ring: every bit emitted into it travels all the way around, changing each component once per bit
+	const size_t n = 1024;
+	std::vector<SynchrotronComponent<16>*> c;
+	for (size_t i = 0; i < n; i++) c.push_back(new SynchrotronComponent<16>(0));
+	for (size_t i = 0; i < n; i++) c[i]->addInput(*c[(i + n - 1) % n]);
+
+	Netlist<16> netlist(c);
+	AdaptiveEngine<16> engine(netlist);
+	size_t failed = 0;
+
+	for (int mode = 0; mode < 2; mode++) {
+		for (size_t i = 0; i < netlist.size(); i++) netlist.setState(i, 0);
+
+		std::vector<size_t> sources;
+		for (size_t b = 0; b < 16; b++) {
+			sources.push_back(netlist.indexOf(c[b * n / 16]));
+			netlist.setState(sources.back(), std::bitset<16>(1 << b));
+		}
+
+		std::vector<std::bitset<16> > before;
+		for (size_t i = 0; i < netlist.size(); i++) before.push_back(netlist.getState(i));
+
+		engine.setMode(mode ? AdaptiveEngine<16>::Levelized : AdaptiveEngine<16>::EventDriven);
+		const size_t changes = engine.propagate(sources);
+
+		// States only gain bits, so every component that changed at all differs now
+		size_t components = 0;
+		for (size_t i = 0; i < netlist.size(); i++) components += netlist.getState(i) != before[i];
+
+		const double activity = engine.stats().lastActivity;
+		printf("%-12s %6d changing evaluations, %4d of %4d components changed, activity factor %.3f\n",
+			mode ? "Levelized" : "EventDriven", int(changes), int(components), int(netlist.size()), activity);
+		failed += activity > 1 || activity != double(components) / netlist.size() || changes <= components;
+	}
+
+	for (auto x : c) delete x;
+
+	printf(failed ? "FAILED: the activity factor counted components more than once\n" : "OK: the activity factor counts each changed component once\n");
+	return failed ? 1 : 0;
+}
+#endif // TEST_ADAPTIVE
+
+#if defined(TEST_PDES) || defined(TEST_DETERMINISM) || defined(TEST_WATCHPOINTS)
+#include "SynchrotronEventDriven.hpp"
+#include "SynchrotronPDES.hpp"
+#include "SynchrotronTimeWarp.hpp"
+
+typedef std::vector<std::pair<size_t, std::bitset<16> > > Stimulus;
+
+// Platform independent pseudo random numbers, so every run builds the same netlist
+uint32_t lcg(uint32_t& seed) {
+	seed = seed * 1103515245u + 12345u;
+	return seed >> 8;
+}
+
+// n components with random states; all but the first sources have 1 to 3 random inputs, closing cycles
+std::vector<SynchrotronComponent<16>*> randomComponents(size_t n, size_t sources, uint32_t seed) {
+	std::vector<SynchrotronComponent<16>*> c;
+	for (size_t i = 0; i < n; i++)
+		c.push_back(new SynchrotronComponent<16>(lcg(seed) % 4 ? 0 : size_t(1) << (lcg(seed) % 16)));
+
+	for (size_t i = sources; i < n; i++)
+		for (uint32_t k = 1 + lcg(seed) % 3; k--;)
+			c[i]->addInput(*c[lcg(seed) % n]);
+
+	return c;
+}
+
+// States after settling the stimulus sequentially, the reference for the parallel engines
+std::vector<std::bitset<16> > settled(Netlist<16>& netlist, const Stimulus& stimulus) {
+	std::vector<std::bitset<16> > states;
+	EventDrivenEngine<16> events(netlist);
+
+	netlist.load();
+	for (auto& s : stimulus) events.emit(netlist.handle(s.first), s.second);
+	for (size_t i = 0; i < netlist.size(); i++) states.push_back(netlist.getState(i));
+	netlist.load();
+
+	return states;
+}
+
+// Compares the working states of netlist with expected
+size_t mismatches(const Netlist<16>& netlist, const std::vector<std::bitset<16> >& expected) {
+	size_t wrong = 0;
+	for (size_t i = 0; i < netlist.size(); i++) wrong += netlist.getState(i) != expected[i];
+	return wrong;
+}
+
+#endif // TEST_PDES || TEST_DETERMINISM || TEST_WATCHPOINTS
+
+#ifdef TEST_PDES
+// Skewed load: a long, fast chain (partition 0) feeds into a short, slow one (partition 1).
+// Partition 1 runs far ahead in simulated time, so the updates of partition 0 arrive as stragglers.
+size_t testRollbacks(ThreadPool& pool) {
+	std::vector<SynchrotronComponent<16>*> fast, slow, all;
+	for (int i = 0; i < 2000; i++) fast.push_back(new SynchrotronComponent<16>(0));
+	for (int i = 0; i < 300; i++) slow.push_back(new SynchrotronComponent<16>(0));
+	for (int i = 1; i < 2000; i++) fast[i]->addInput(*fast[i - 1]);
+	for (int i = 1; i < 300; i++) slow[i]->addInput(*slow[i - 1]);
+	for (int k = 1; k < 20; k++) slow[k * 15]->addInput(*fast[k * 100]);
+
+	all.insert(all.end(), fast.begin(), fast.end());
+	all.insert(all.end(), slow.begin(), slow.end());
+	Netlist<16> netlist(all);
+
+	std::vector<size_t> partitionOf(netlist.size());
+	for (auto x : slow) partitionOf[netlist.indexOf(x)] = 1;
+
+	Stimulus stimulus;
+	stimulus.push_back(std::make_pair(netlist.indexOf(fast[0]), std::bitset<16>(0x0F0F)));
+	stimulus.push_back(std::make_pair(netlist.indexOf(slow[0]), std::bitset<16>(0x1000)));
+	const std::vector<std::bitset<16> > expected = settled(netlist, stimulus);
+
+	OptimisticEngine<16> engine(netlist, partitionOf);
+	for (auto x : slow) engine.setDelay(netlist.indexOf(x), 10);
+	for (auto& s : stimulus) engine.schedule(0, s.first, s.second);
+
+	engine.run(1 << 13, pool);
+	const size_t wrong = mismatches(netlist, expected);
+	printf("Skewed Time Warp:   %8d events, %8d rollbacks,     %5d states differ from EventDrivenEngine\n",
+		int(engine.committed()), int(engine.rolledBack()), int(wrong));
+
+	for (auto x : all) delete x;
+	return wrong + (engine.rolledBack() == 0);
+}
+
+int testPDES() {
+	const size_t parts = 4;
+	std::vector<SynchrotronComponent<16>*> c = randomComponents(ELEMENTS, 16, 1);
+	Netlist<16> netlist(c);
+
+	Stimulus stimulus;
+	for (size_t i = 0; i < 16; i++)
+		stimulus.push_back(std::make_pair(netlist.indexOf(c[i]), std::bitset<16>(1 << i)));
+	const std::vector<std::bitset<16> > expected = settled(netlist, stimulus);
+
+	size_t failed = 0;
+	ThreadPool pool(parts);
+
+	{
+		// Delays of 64 to 70 give every partition a lookahead of 64
+		ConservativeEngine<16> engine(netlist, netlist.blocks(parts));
+		for (size_t i = 0; i < netlist.size(); i++) engine.setDelay(i, 64 + i % 7);
+		for (size_t k = 0; k < stimulus.size(); k++) engine.schedule(10 * k, stimulus[k].first, stimulus[k].second);
+
+		engine.run(1 << 13, pool);
+		const size_t wrong = mismatches(netlist, expected);
+		printf("ConservativeEngine: %8d events, %8d null messages, %5d states differ from EventDrivenEngine\n",
+			int(engine.processed()), int(engine.nullMessages()), int(wrong));
+		failed += wrong + (engine.nullMessages() == 0);
+		netlist.load();
+	}
+
+	{
+		OptimisticEngine<16> engine(netlist, netlist.blocks(parts));
+		for (size_t i = 0; i < netlist.size(); i++) engine.setDelay(i, 64 + i % 7);
+		for (size_t k = 0; k < stimulus.size(); k++) engine.schedule(10 * k, stimulus[k].first, stimulus[k].second);
+
+		engine.run(1 << 13, pool);
+		const size_t wrong = mismatches(netlist, expected);
+		printf("OptimisticEngine:   %8d events, %8d rollbacks,     %5d states differ from EventDrivenEngine\n",
+			int(engine.committed()), int(engine.rolledBack()), int(wrong));
+		failed += wrong;
+		netlist.load();
+	}
+
+	failed += testRollbacks(pool);
+
+	for (auto x : c) delete x;
+
+	printf(failed ? "FAILED: parallel engines disagree with the sequential one\n" : "OK: parallel engines settle like the sequential one\n");
+	return failed ? 1 : 0;
+}
+#endif // TEST_PDES
+
+#ifdef TEST_DETERMINISM
+#include <functional>
+
+#include "SynchrotronDataflow.hpp"
+#include "SynchrotronLevelized.hpp"
+
+// Runs an engine from the same initial states on pools of 1 to 4 workers and compares the traces
+size_t sameTraces(const char* name, Netlist<16>& netlist, const std::function<void(ThreadPool&, CommitLog<16>&)>& run) {
+	uint64_t first = 0;
+	size_t failed = 0, changes = 0;
+
+	for (size_t workers = 1; workers <= 4; workers++) {
+		ThreadPool pool(workers);
+		CommitLog<16> log;
+
+		netlist.load();
+		run(pool, log);
+
+		if (workers == 1) {
+			first	= log.digest();
+			changes	= log.trace().size();
+		}
+		failed += log.digest() != first || log.trace().size() != changes;
+	}
+
+	netlist.load();
+	printf("%-20s %8d changes, traces of 1 to 4 workers %s\n", name, int(changes), failed ? "DIFFER" : "identical");
+	return failed;
+}
+
+int testDeterminism() {
+	std::vector<SynchrotronComponent<16>*> c = randomComponents(ELEMENTS, 16, 2);
+	Netlist<16> netlist(c);
+	const std::vector<size_t> partitionOf = netlist.blocks(4);
+	size_t failed = 0;
+
+	failed += sameTraces("LevelizedEngine", netlist, [&](ThreadPool& pool, CommitLog<16>& log) {
+		LevelizedEngine<16> engine(netlist);
+		engine.setLog(&log);
+		for (int k = 0; k < 4; k++) engine.step(pool);
+	});
+
+	failed += sameTraces("DataflowExecutor", netlist, [&](ThreadPool& pool, CommitLog<16>& log) {
+		DataflowExecutor<16> engine(netlist, pool);
+		engine.setLog(&log);
+		for (size_t i = 0; i < 16; i++) engine.emit(*c[i], std::bitset<16>(1 << i));
+	});
+
+	failed += sameTraces("ConservativeEngine", netlist, [&](ThreadPool& pool, CommitLog<16>& log) {
+		ConservativeEngine<16> engine(netlist, partitionOf);
+		engine.setLog(&log);
+		for (size_t i = 0; i < netlist.size(); i++) engine.setDelay(i, 64 + i % 7);
+		for (size_t i = 0; i < 16; i++) engine.schedule(10 * i, netlist.indexOf(c[i]), std::bitset<16>(1 << i));
+		engine.run(1 << 13, pool);
+	});
+
+	failed += sameTraces("OptimisticEngine", netlist, [&](ThreadPool& pool, CommitLog<16>& log) {
+		OptimisticEngine<16> engine(netlist, partitionOf);
+		engine.setLog(&log);
+		for (size_t i = 0; i < netlist.size(); i++) engine.setDelay(i, 64 + i % 7);
+		for (size_t i = 0; i < 16; i++) engine.schedule(10 * i, netlist.indexOf(c[i]), std::bitset<16>(1 << i));
+		engine.run(1 << 13, pool);
+	});
+
+	for (auto x : c) delete x;
+
+	printf(failed ? "FAILED: traces depend on the amount of workers\n" : "OK: traces are bit-identical for any amount of workers\n");
+	return failed ? 1 : 0;
+}
+#endif // TEST_DETERMINISM
+
+#ifdef TEST_PACKED
+#include "SynchrotronLevelized.hpp"
+#include "SynchrotronPacked.hpp"
+
+int testPacked() {
+	// Random 1-bit components with cycles: 1 in 8 set, all but the first 64 with 1 to 3 inputs
+	uint32_t seed = 3;
+	auto random = [&seed]() { seed = seed * 1103515245u + 12345u; return seed >> 8; };
+
+	std::vector<SynchrotronComponent<1>*> c;
+	for (int i = 0; i < ELEMENTS; i++) c.push_back(new SynchrotronComponent<1>(random() % 8 == 0));
+	for (int i = 64; i < ELEMENTS; i++)
+		for (uint32_t k = 1 + random() % 3; k--;)
+			c[i]->addInput(*c[random() % (random() % 16 ? i : ELEMENTS)]);
+
+	Netlist<1> netlist(c);
+	PackedNetlist packed(netlist);
+	LevelizedEngine<1> levelized(netlist);
+
+	size_t failed = 0;
+	for (int round = 0; round < TIMES; round++) {
+		// New stimulus on the sources, then one step of both
+		for (size_t i = 0; i < 64; i++) {
+			const bool value = random() % 2;
+			netlist.setState(netlist.indexOf(c[i]), value);
+			packed.setState(netlist.indexOf(c[i]), value);
+		}
+
+		levelized.step();
+		packed.step();
+
+		size_t wrong = 0;
+		for (size_t i = 0; i < netlist.size(); i++) wrong += netlist.getState(i)[0] != packed.getState(i);
+		failed += wrong + !packed.settled();
+	}
+
+	printf("PackedNetlist: %d gates, %d levels, %d bytes (%.1f per gate), %d mismatches with LevelizedEngine in %d steps\n",
+		int(packed.size()), int(packed.levels()), int(packed.bytes()), double(packed.bytes()) / packed.size(), int(failed), TIMES);
+
+	// A ring of three inverters oscillates; step() has to give up and say so
+	PackedNetlist ring;
+	for (int i = 0; i < 3; i++) ring.add(PackedNetlist::Nand);
+	for (int i = 0; i < 3; i++) ring.connect(i, (i + 1) % 3);
+	ring.step();
+	printf("Ring oscillator: settled() = %s\n", BSTR(ring.settled()));
+	failed += ring.settled();
+
+	for (auto x : c) delete x;
+
+	printf(failed ? "FAILED: packed evaluation differs\n" : "OK: packed evaluation matches the bitset Netlist\n");
+	return failed ? 1 : 0;
+}
+#endif // TEST_PACKED
+
+#ifdef TEST_WATCHPOINTS
+#include <atomic>
+#include <stdexcept>
+
+#include "SynchrotronClock.hpp"
+#include "SynchrotronWatch.hpp"
+
+// Runs engine over netlist on the stimulus, then checks that watchpoint w triggers
+template <class Engine>
+size_t observedRun(Engine& engine, const Netlist<16>& netlist, const Stimulus& stimulus, Watchpoints<16>& watchpoints, Watchpoints<16>::Id w) {
+	ThreadPool pool(4);
+	for (size_t i = 0; i < netlist.size(); i++) engine.setDelay(i, 64 + i % 7);
+	for (size_t k = 0; k < stimulus.size(); k++) engine.schedule(10 * k, stimulus[k].first, stimulus[k].second);
+	engine.run(1 << 13, pool);
+
+	return watchpoints.check() != 1 || watchpoints.hits()[0] != w;
+}
+
+// The timed engines apply updates instead of evaluating; they must notify all the same,
+// the optimistic one only of committed changes, so both report the very same changes
+int testTimedWatchpoints() {
+	std::vector<SynchrotronComponent<16>*> c = randomComponents(2000, 16, 5);
+	Netlist<16> netlist(c);
+
+	Stimulus stimulus;
+	for (size_t i = 0; i < 16; i++)
+		stimulus.push_back(std::make_pair(netlist.indexOf(c[i]), std::bitset<16>(1 << i)));
+	const std::vector<std::bitset<16> > expected = settled(netlist, stimulus);
+
+	size_t target = netlist.size() - 1;
+	while (target > 0 && expected[target] == netlist.getState(target)) target--;
+
+	std::atomic<size_t> changes(0);
+	Observers<16> observers;
+	for (size_t i = 0; i < netlist.size(); i++)
+		observers.watch(i, [&changes](size_t, const std::bitset<16>&) { changes++; });
+
+	Watchpoints<16> watchpoints(netlist, observers);
+	const auto w = watchpoints.add({ Watchpoints<16>::equals(netlist.handle(target), expected[target]) });
+	watchpoints.check();
+
+	ConservativeEngine<16> conservative(netlist, netlist.blocks(4));
+	size_t failed = observedRun(conservative, netlist, stimulus, watchpoints, w);
+	const size_t reference = changes.exchange(0);
+	printf("ConservativeEngine: %6d changes observed, watchpoint hit %d time(s)\n", int(reference), int(watchpoints.watchpoint(w).hits));
+
+	// Back to the initial states, which the watchpoint learns on its next check
+	netlist.load();
+	watchpoints.setEnabled(w, true);
+	watchpoints.check();
+
+	OptimisticEngine<16> optimistic(netlist, netlist.blocks(4));
+	failed += observedRun(optimistic, netlist, stimulus, watchpoints, w);
+	printf("OptimisticEngine:   %6d changes observed, watchpoint hit %d time(s), %d rollbacks\n",
+		int(changes.load()), int(watchpoints.watchpoint(w).hits), int(optimistic.rolledBack()));
+
+	failed += reference == 0 || changes.load() != reference || watchpoints.watchpoint(w).hits != 2;
+	failed += mismatches(netlist, expected);
+
+	netlist.setObservers(nullptr);
+	for (auto x : c) delete x;
+	return failed;
+}
+
+int testWatchpoints() {
+	// A source feeding a shift register of 5 stages, which moves its value one stage per edge
+	std::vector<SynchrotronComponent<16>*> c;
+	for (int i = 0; i < 6; i++) c.push_back(new SynchrotronComponent<16>(0));
+	for (int i = 1; i < 6; i++) c[i]->addInput(*c[i - 1]);
+
+	Netlist<16> netlist(c);
+	ClockScheduler<16> clock(netlist);
+	const auto domain = clock.addDomain(10);
+	for (int i = 1; i < 6; i++) clock.subscribe(*c[i], domain);
+
+	const Handle third = netlist.handle(netlist.indexOf(c[3])), last = netlist.handle(netlist.indexOf(c[5]));
+	size_t failed = 0;
+
+	// A monitor already attached keeps its callbacks, another registry is refused
+	Observers<16> observers, other;
+	size_t lastChanged = 0;
+	observers.watch(netlist.indexOf(c[5]), [&lastChanged](size_t, const std::bitset<16>&) { lastChanged++; });
+	netlist.setObservers(&observers);
+
+	try {
+		Watchpoints<16> refused(netlist, other);
+		failed++;
+	} catch (const std::invalid_argument&) {}
+
+	Watchpoints<16> watchpoints(netlist, observers);
+	const auto bit = watchpoints.add({ Watchpoints<16>::bits(third, 0x1, 0x1) });
+	const auto full = watchpoints.add({ Watchpoints<16>::equals(last, 0x5), Watchpoints<16>::bits(third, 0x4, 0x4) });
+	clock.setWatchpoints(&watchpoints);
+
+	const size_t source = netlist.indexOf(c[0]);
+	netlist.setState(source, 0x5);
+	clock.changed(source);
+
+	// Edges are at 0, 10, 20, ...: stage k takes the value at the kth edge, at time 10 * (k - 1)
+	auto stops = [&](const char* name, SimTime at, size_t hit) {
+		clock.run(1000);
+		const bool ok = clock.now() == at && watchpoints.hits().size() == 1 && watchpoints.hits()[0] == hit;
+		printf("%-26s stopped at %4d, %d hit(s): %s\n", name, int(clock.now()), int(watchpoints.hits().size()), ok ? "ok" : "WRONG");
+		failed += !ok;
+	};
+
+	stops("bits(stage 3, 0x1, 0x1)", 20, bit);
+	failed += netlist.getState(netlist.indexOf(c[4])) != 0;	// Stopped right at that step, not later
+	stops("equals(stage 5, 0x5)", 40, full);
+
+	clock.run(1000);
+	printf("%-26s stopped at %4d, %d hit(s)\n", "rest", int(clock.now()), int(watchpoints.hits().size()));
+	failed += clock.now() != 1000 || !watchpoints.hits().empty();
+	failed += lastChanged != 1 || watchpoints.watchpoint(bit).hits != 1 || watchpoints.watchpoint(full).hits != 1;
+
+	clock.setWatchpoints(nullptr);
+	for (auto x : c) delete x;
+
+	failed += testTimedWatchpoints();
+
+	printf(failed ? "FAILED: watchpoints missed their conditions\n" : "OK: watchpoints trigger where their conditions first hold\n");
+	return failed ? 1 : 0;
+}
+#endif // TEST_WATCHPOINTS
+
+#ifdef TEST_INGRESS
+#include <atomic>
+#include <thread>
+
+#include "SynchrotronEventDriven.hpp"
+
+int testIngress() {
+	// Every writer, and a flooding one, drives its own chain; the simulation thread propagates in slices
+	const size_t writers = 4, length = 2000;
+	std::vector<SynchrotronComponent<16>*> c;
+	for (size_t w = 0; w <= writers; w++) {
+		for (size_t k = 0; k < length; k++) {
+			c.push_back(new SynchrotronComponent<16>(0));
+			if (k) c.back()->addInput(*c[c.size() - 2]);
+		}
+	}
+
+	Netlist<16> netlist(c);
+	EventDrivenEngine<16> engine(netlist);
+	Ingress<16> ingress(8);
+	engine.setIngress(&ingress);
+
+	std::atomic<bool> stop(false), flooding(true);
+	std::thread simulation([&]() {
+		const EventDrivenEngine<16>::Budget slice = { 64, std::chrono::nanoseconds(0), StopToken() };
+		while (!stop.load()) engine.propagate(slice);
+	});
+
+	// Keeps the ring full, so the others settle while writes never stop coming and many get rejected
+	std::thread flood([&]() {
+		const Handle source = netlist.handle(netlist.indexOf(c[writers * length]));
+		for (uint32_t k = 0; flooding.load(); k++) ingress.write(source, std::bitset<16>(1 << (k % 16)));
+	});
+
+	// Writer w sends bit r in round r, so the end of its chain lacks it until its own write settled
+	std::atomic<size_t> late(0), elsewhere(0);
+	auto writer = [&](size_t w) {
+		const Handle source = netlist.handle(netlist.indexOf(c[w * length]));
+		const size_t last = netlist.indexOf(c[w * length + length - 1]);
+
+		for (size_t r = 0; r < 16; r++) {
+			const std::bitset<16> bit(1 << r);
+			while (!ingress.write(source, bit)) std::this_thread::yield();
+
+			const std::thread::id nobody;
+			std::atomic<std::thread::id> ranOn(nobody);
+			ingress.onSettled([&ranOn]() { ranOn.store(std::this_thread::get_id()); });
+			ingress.settled().wait();
+
+			// Callbacks run before futures become ready: on the simulation thread, or right here when already settled
+			const std::thread::id id = ranOn.load();
+			elsewhere	+= id != simulation.get_id() && id != std::this_thread::get_id();
+			late		+= (netlist.getState(last) & bit) != bit;
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (size_t w = 0; w < writers; w++) threads.push_back(std::thread(writer, w));
+	for (auto& t : threads) t.join();
+
+	flooding.store(false);
+	flood.join();
+	ingress.settled().wait();
+	stop.store(true);
+	simulation.join();
+
+	printf("%d writers x 16 writes: %d settled before propagating, %d callbacks on a writer, %d of the flood rejected, %d pending\n",
+		int(writers), int(late.load()), int(elsewhere.load()), int(ingress.overflows()), int(ingress.pending()));
+	size_t failed = late.load() + elsewhere.load() + (ingress.overflows() == 0) + ingress.pending();
+
+	// A write whose propagation is discarded settles too, or its writer would wait forever
+	SynchrotronComponent<16> first(0), second(0), third(0);
+	second.addInput(first);
+	third.addInput(second);
+	std::vector<SynchrotronComponent<16>*> three = { &first, &second, &third };
+	Netlist<16> line(three);
+	EventDrivenEngine<16> cut(line);
+	Ingress<16> input(8);
+	cut.setIngress(&input);
+
+	const EventDrivenEngine<16>::Budget one = { 1, std::chrono::nanoseconds(0), StopToken() };
+	input.write(line.handle(line.indexOf(&first)), std::bitset<16>(1));
+	std::future<void> discarded = input.settled();
+	const bool suspended = cut.propagate(one) == EventDrivenEngine<16>::Suspended;
+	cut.discard();
+	const bool released = discarded.wait_for(std::chrono::seconds(1)) == std::future_status::ready;
+	printf("Discarded propagation: suspended = %s, writer released = %s, %d pending\n", BSTR(suspended), BSTR(released), int(input.pending()));
+	failed += !suspended + !released + input.pending();
+
+	for (auto x : c) delete x;
+
+	printf(failed ? "FAILED: a writer settled too early, was notified on the wrong thread or never released\n" : "OK: every writer settles on its own write, notified by the simulation\n");
+	return failed ? 1 : 0;
+}
+#endif // TEST_INGRESS
+
+#ifdef TEST_PACED
+#include "SynchrotronPacer.hpp"
+
+void testPaced() {
+	// A core register feeding ELEMENTS combinational components, clocked at 1 MHz
+	std::vector<SynchrotronComponent<16>*> c;
+	for (int i = 0; i <= ELEMENTS; i++) c.push_back(new SynchrotronComponent<16>(0));
+	for (int i = 1; i <= ELEMENTS; i++) c[i]->addInput(*c[i - 1]);
+
+	Netlist<16> netlist(c);
+	ClockScheduler<16> scheduler(netlist);
+	scheduler.subscribe(0, scheduler.addDomain(1));
+
+	printf("| Batch (cycles) | Batches | Overruns | Mean jitter (ns) | Max jitter (ns) | Load |\n");
+	for (SimTime batch = 10; batch <= 10000; batch *= 10) {
+		Pacer<16> pacer(scheduler, std::chrono::nanoseconds(1000), batch);
+		const PaceStats &s = pacer.run(200000);
+
+		printf("| %14d | %7d | %8d | %16.0f | %15d | %3.0f%% |\n", int(batch), int(s.batches), int(s.overruns),
+			s.meanLateness, int(s.maxLateness), s.load * 100);
+	}
+
+	for (auto x : c) delete x;
+}
+#endif // TEST_PACED
+
 int main() {
-#ifndef TEST_PERFORMANCE
+#if defined(TEST_BARRIER)
+	testBarrier();
+#elif defined(TEST_CHANNEL)
+	testChannel();
+#elif defined(TEST_FALSE_SHARING)
+	testFalseSharing();
+#elif defined(TEST_ALLOCATIONS)
+	return testAllocations();
+#elif defined(TEST_HYBRID)
+	testHybrid();
+#elif defined(TEST_ADAPTIVE)
+	return testAdaptive();
+#elif defined(TEST_PACED)
+	testPaced();
+#elif defined(TEST_PDES)
+	return testPDES();
+#elif defined(TEST_DETERMINISM)
+	return testDeterminism();
+#elif defined(TEST_PACKED)
+	return testPacked();
+#elif defined(TEST_WATCHPOINTS)
+	return testWatchpoints();
+#elif defined(TEST_INGRESS)
+	return testIngress();
+#elif !defined(TEST_PERFORMANCE)
 	SYNCHROTRON slot(1);
 	SYNCHROTRON signal(2);
 